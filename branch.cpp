@@ -0,0 +1,192 @@
+#include <cinttypes>
+#include <cstdlib>
+#include <cstring>
+#include "branch.hpp"
+
+const bp_config_t DEFAULT_BP_CONFIG = { BP_PERFECT, BP_DEFAULT_BITS, 2 };
+
+// History length of each tagged TAGE table, roughly geometric
+static const uint32_t tage_history[BP_TAGE_TABLES] = { 4, 10, 24, 56 };
+
+#define TAGE_TAG_BITS 12
+#define TAGE_CTR_MAX 3
+#define TAGE_CTR_MIN -4
+#define TAGE_USEFUL_MAX 3
+// Useful counters are halved every this many updates, so stale entries can be replaced
+#define TAGE_USEFUL_RESET (1 << 18)
+
+bool bp_parse(const char* arg, bp_config_t* config)
+{
+    static const struct { const char* name; bp_kind_t kind; } kinds[] = {
+        { "perfect", BP_PERFECT }, { "bimodal", BP_BIMODAL }, { "gshare", BP_GSHARE }, { "tage", BP_TAGE }
+    };
+    const char* colon = strchr(arg, ':');
+    size_t len = colon ? static_cast<size_t>(colon - arg) : strlen(arg);
+    bool found = false;
+    for (const auto& k : kinds) {
+        if (strlen(k.name) == len && strncmp(arg, k.name, len) == 0) {
+            config->kind = k.kind;
+            found = true;
+        }
+    }
+    if (!found) return false;
+    config->table_bits = BP_DEFAULT_BITS;
+    if (colon) {
+        char* end;
+        unsigned long bits = strtoul(colon + 1, &end, 10);
+        if (end == colon + 1 || *end || bits < 1 || bits > 24) return false;
+        config->table_bits = static_cast<uint32_t>(bits);
+    }
+    return true;
+}
+
+void bp_init(branch_pred_t* bp, const bp_config_t& config)
+{
+    bp->config = config;
+    size_t entries = (config.kind == BP_PERFECT) ? 0 : (size_t(1) << config.table_bits);
+    bp->counters.assign(entries, 1);        // Weakly not taken
+    bp_tage_entry_t empty = { 0, 0, 0 };
+    bp->tagged.assign(config.kind == BP_TAGE ? entries * BP_TAGE_TABLES : 0, empty);
+    bp->sites.assign(config.kind == BP_PERFECT ? 0 : (size_t(1) << BP_SITE_BITS) / 64, 0);
+    bp->history = 0;
+    bp->updates = 0;
+    bp->last_pc = 0;
+    bp->has_last = false;
+    bp->instructions = 0;
+    bp->branches = 0;
+    bp->mispredicts = 0;
+}
+
+// Helper: the low `length` bits of the history folded down to `bits` bits
+static inline uint32_t fold_history(uint64_t history, uint32_t length, uint32_t bits) {
+    uint64_t h = (length >= 64) ? history : (history & ((1ULL << length) - 1));
+    uint32_t folded = 0;
+    for (uint32_t done = 0; done < length; done += bits) {
+        folded ^= static_cast<uint32_t>(h) & ((1u << bits) - 1);
+        h >>= bits;
+    }
+    return folded;
+}
+
+// Helper: move a 2-bit counter towards the outcome
+static inline void train_2bit(uint8_t* ctr, bool taken) {
+    if (taken && *ctr < 3) ++*ctr;
+    if (!taken && *ctr > 0) --*ctr;
+}
+
+// Helper: TAGE prediction for pc, trained with the actual outcome; returns the prediction
+static bool tage_predict_update(branch_pred_t* bp, uint32_t pc, bool taken) {
+    uint32_t bits = bp->config.table_bits;
+    size_t mask = (size_t(1) << bits) - 1;
+    uint32_t word = pc >> 2;
+    bp_tage_entry_t* entry[BP_TAGE_TABLES];
+    uint16_t tag[BP_TAGE_TABLES];
+    int provider = -1;
+    int alt = -1;
+    for (int t = BP_TAGE_TABLES - 1; t >= 0; --t) {
+        uint32_t index = (word ^ (word >> bits) ^ fold_history(bp->history, tage_history[t], bits)) & mask;
+        tag[t] = static_cast<uint16_t>((word ^ fold_history(bp->history, tage_history[t], TAGE_TAG_BITS) ^
+                                        (fold_history(bp->history, tage_history[t], TAGE_TAG_BITS - 1) << 1)) &
+                                       ((1u << TAGE_TAG_BITS) - 1));
+        entry[t] = &bp->tagged[t * (mask + 1) + index];
+        if (entry[t]->tag == tag[t]) {
+            if (provider < 0) provider = t;
+            else if (alt < 0) alt = t;
+        }
+    }
+    uint8_t* base = &bp->counters[word & mask];
+    bool base_pred = *base >= 2;
+    bool alt_pred = (alt >= 0) ? entry[alt]->ctr >= 0 : base_pred;
+    bool pred = (provider >= 0) ? entry[provider]->ctr >= 0 : base_pred;
+
+    if (provider >= 0) {
+        bp_tage_entry_t* e = entry[provider];
+        if (taken && e->ctr < TAGE_CTR_MAX) e->ctr++;
+        if (!taken && e->ctr > TAGE_CTR_MIN) e->ctr--;
+        if (pred != alt_pred) {
+            if (pred == taken && e->useful < TAGE_USEFUL_MAX) e->useful++;
+            if (pred != taken && e->useful > 0) e->useful--;
+        }
+    } else {
+        train_2bit(base, taken);
+    }
+
+    // On a misprediction, claim an entry in a table with longer history
+    if (pred != taken && provider < BP_TAGE_TABLES - 1) {
+        bool allocated = false;
+        for (int t = provider + 1; t < BP_TAGE_TABLES && !allocated; ++t) {
+            if (entry[t]->useful == 0) {
+                entry[t]->tag = tag[t];
+                entry[t]->ctr = taken ? 0 : -1;
+                allocated = true;
+            }
+        }
+        for (int t = provider + 1; t < BP_TAGE_TABLES && !allocated; ++t) {
+            entry[t]->useful--;
+        }
+    }
+    if (++bp->updates % TAGE_USEFUL_RESET == 0) {
+        for (auto& e : bp->tagged) e.useful >>= 1;
+    }
+    return pred;
+}
+
+bool bp_resolve(branch_pred_t* bp, uint32_t pc, uint32_t next_pc)
+{
+    bp->instructions++;
+    if (bp->config.kind == BP_PERFECT) return false;
+    bool taken = next_pc != pc + 4;
+    uint32_t site = (pc >> 2) & ((1u << BP_SITE_BITS) - 1);
+    uint64_t site_bit = 1ULL << (site & 63);
+    bool known = (bp->sites[site >> 6] & site_bit) != 0;
+    if (!known) {
+        if (!taken) return false;
+        bp->sites[site >> 6] |= site_bit;
+    }
+    bp->branches++;
+
+    size_t mask = (size_t(1) << bp->config.table_bits) - 1;
+    bool pred = false;
+    switch (bp->config.kind) {
+    case BP_BIMODAL: {
+        uint8_t* ctr = &bp->counters[(pc >> 2) & mask];
+        pred = *ctr >= 2;
+        train_2bit(ctr, taken);
+        break;
+    }
+    case BP_GSHARE: {
+        uint8_t* ctr = &bp->counters[((pc >> 2) ^ bp->history) & mask];
+        pred = *ctr >= 2;
+        train_2bit(ctr, taken);
+        break;
+    }
+    case BP_TAGE:
+        pred = tage_predict_update(bp, pc, taken);
+        break;
+    case BP_PERFECT:
+        break;
+    }
+    bp->history = (bp->history << 1) | (taken ? 1 : 0);
+
+    // A site seen for the first time was fetched as a plain instruction
+    bool mispredicted = known ? pred != taken : true;
+    if (mispredicted) bp->mispredicts++;
+    return mispredicted;
+}
+
+void bp_replay(branch_pred_t* bp, const trace_inst_t* insts, size_t n)
+{
+    for (size_t i = 0; i < n; ++i) {
+        if (bp->has_last) bp_resolve(bp, bp->last_pc, insts[i].instruction_address);
+        bp->last_pc = insts[i].instruction_address;
+        bp->has_last = true;
+    }
+}
+
+void bp_print_stats(FILE* out, const branch_pred_t* bp, uint64_t instructions)
+{
+    if (bp->config.kind == BP_PERFECT) return;
+    fprintf(out, "Branches: %" PRIu64 ", mispredicted: %" PRIu64 " (%.2f%%), MPKI: %.3f\n",
+            bp->branches, bp->mispredicts, bp->branches ? 100.0 * bp->mispredicts / bp->branches : 0.0,
+            instructions ? 1000.0 * bp->mispredicts / instructions : 0.0);
+}
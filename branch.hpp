@@ -0,0 +1,83 @@
+#ifndef BRANCH_HPP
+#define BRANCH_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include "trace.hpp"
+
+// Branch prediction for the trace-driven front end. The trace holds no branch
+// information, so branches are inferred from PC discontinuities: an instruction
+// followed by anything but pc + 4 is a taken branch, and its PC is remembered as
+// a branch site. Later fall-throughs at a known site are not-taken outcomes.
+// Sites not yet seen taken are implicitly predicted not taken. Targets are not
+// predicted (every taken branch is assumed to hit in the BTB).
+//
+//  perfect: no mispredictions (the default)
+//  bimodal: 2-bit counters indexed by PC
+//  gshare:  2-bit counters indexed by PC xor global history
+//  tage:    bimodal base plus BP_TAGE_TABLES tagged tables with geometrically
+//           growing history lengths (a TAGE-lite without loop or SC components)
+enum bp_kind_t
+{
+    BP_PERFECT,
+    BP_BIMODAL,
+    BP_GSHARE,
+    BP_TAGE
+};
+
+#define BP_DEFAULT_BITS 12
+#define BP_SITE_BITS 16
+#define BP_TAGE_TABLES 4
+
+typedef struct _bp_config_t
+{
+    bp_kind_t kind;
+    uint32_t table_bits;      // log2 of the entries per table
+    uint64_t penalty;         // Cycles from resolving a mispredict to fetching again
+} bp_config_t;
+
+// One tagged TAGE entry, 4 bytes
+typedef struct _bp_tage_entry_t
+{
+    uint16_t tag;
+    int8_t ctr;               // 3-bit signed counter, >= 0 predicts taken
+    uint8_t useful;
+} bp_tage_entry_t;
+
+typedef struct _branch_pred_t
+{
+    bp_config_t config;
+    std::vector<uint8_t> counters;          // bimodal, gshare or TAGE base table
+    std::vector<bp_tage_entry_t> tagged;    // BP_TAGE_TABLES tables, table-major
+    std::vector<uint64_t> sites;            // Bitmap of known branch sites, by hashed PC
+    uint64_t history;                       // Global outcome history, newest in bit 0
+    uint64_t updates;
+    uint32_t last_pc;                       // bp_replay(): previous instruction, if any
+    bool has_last;
+
+    uint64_t instructions;
+    uint64_t branches;
+    uint64_t mispredicts;
+} branch_pred_t;
+
+// Perfect prediction, two cycles of redirect penalty
+extern const bp_config_t DEFAULT_BP_CONFIG;
+
+// Parse "KIND[:BITS]" with KIND one of perfect, bimodal, gshare, tage; false if malformed
+bool bp_parse(const char* arg, bp_config_t* config);
+
+// Reset the predictor to empty tables of the given configuration
+void bp_init(branch_pred_t* bp, const bp_config_t& config);
+
+// Resolve the instruction at pc now that the next one (at next_pc) is known:
+// predict it, train the predictor and return whether the front end mispredicted it
+bool bp_resolve(branch_pred_t* bp, uint32_t pc, uint32_t next_pc);
+
+// Run n trace instructions through the predictor alone, without timing
+void bp_replay(branch_pred_t* bp, const trace_inst_t* insts, size_t n);
+
+// Print branch counts, mispredictions and MPKI over `instructions` instructions
+void bp_print_stats(FILE* out, const branch_pred_t* bp, uint64_t instructions);
+
+#endif /* BRANCH_HPP */
@@ -0,0 +1,121 @@
+#include <cinttypes>
+#include <cstdlib>
+#include <cstring>
+#include "cache.hpp"
+
+const mem_config_t DEFAULT_MEM_CONFIG = { { 0, 0, 0, 0 }, { 0, 0, 0, 0 }, { 0, 0, 0, 0 }, 100 };
+
+bool cache_parse(const char* arg, cache_config_t* config)
+{
+    uint64_t v[4];
+    const char* p = arg;
+    for (int i = 0; i < 4; ++i) {
+        char* end;
+        v[i] = strtoull(p, &end, 10);
+        if (end == p) return false;
+        p = end;
+        if (i == 0 && (*p == 'k' || *p == 'K')) {
+            v[i] <<= 10;
+            ++p;
+        } else if (i == 0 && (*p == 'm' || *p == 'M')) {
+            v[i] <<= 20;
+            ++p;
+        }
+        if (i < 3 && *p++ != ':') return false;
+    }
+    if (*p) return false;
+    config->size = v[0];
+    config->assoc = v[1];
+    config->block = v[2];
+    config->latency = v[3];
+    // Block size a power of two, and a whole power-of-two number of sets
+    if (v[1] == 0 || v[2] == 0 || (v[2] & (v[2] - 1)) != 0) return false;
+    uint64_t sets = v[0] / (v[1] * v[2]);
+    return sets > 0 && sets * v[1] * v[2] == v[0] && (sets & (sets - 1)) == 0;
+}
+
+// Helper: empty cache of the given configuration
+static void cache_init(cache_t* cache, const cache_config_t& config) {
+    cache->config = config;
+    cache->block_bits = 0;
+    cache->sets = 0;
+    cache->accesses = 0;
+    cache->misses = 0;
+    cache->tags.clear();
+    if (config.size == 0) return;
+    while ((1ULL << cache->block_bits) < config.block) cache->block_bits++;
+    cache->sets = config.size / (config.assoc * config.block);
+    cache->tags.assign(cache->sets * config.assoc, 0);
+}
+
+// Helper: look up addr and make its block the most recent of its set; true on a hit
+static bool cache_access(cache_t* cache, uint32_t addr) {
+    uint32_t block = addr >> cache->block_bits;
+    uint32_t tag = block + 1;
+    uint64_t assoc = cache->config.assoc;
+    uint32_t* set = &cache->tags[(block & (cache->sets - 1)) * assoc];
+    cache->accesses++;
+    uint64_t way = 0;
+    while (way < assoc && set[way] != tag) ++way;
+    bool hit = way < assoc;
+    if (!hit) {
+        cache->misses++;
+        way = assoc - 1;      // Evict the least recently used way
+    }
+    memmove(set + 1, set, way * sizeof(uint32_t));
+    set[0] = tag;
+    return hit;
+}
+
+// Helper: latency of an access that missed in an L1
+static uint64_t miss_latency(mem_hier_t* mem, uint32_t addr) {
+    if (mem->config.l2.size == 0) return mem->config.mem_latency;
+    if (cache_access(&mem->l2, addr)) return mem->config.l2.latency;
+    return mem->config.l2.latency + mem->config.mem_latency;
+}
+
+void mem_init(mem_hier_t* mem, const mem_config_t& config)
+{
+    mem->config = config;
+    cache_init(&mem->l1i, config.l1i);
+    cache_init(&mem->l1d, config.l1d);
+    cache_init(&mem->l2, config.l2);
+    mem->last_iblock = 0;
+}
+
+uint64_t mem_fetch(mem_hier_t* mem, uint32_t addr)
+{
+    if (mem->config.l1i.size == 0) return 0;
+    uint64_t block = (addr >> mem->l1i.block_bits) + 1ULL;
+    if (block == mem->last_iblock) return mem->config.l1i.latency;
+    mem->last_iblock = block;
+    if (cache_access(&mem->l1i, addr)) return mem->config.l1i.latency;
+    return mem->config.l1i.latency + miss_latency(mem, addr);
+}
+
+uint64_t mem_data(mem_hier_t* mem, uint32_t addr)
+{
+    if (mem->config.l1d.size == 0) return 0;
+    if (cache_access(&mem->l1d, addr)) return mem->config.l1d.latency;
+    return mem->config.l1d.latency + miss_latency(mem, addr);
+}
+
+void mem_replay(mem_hier_t* mem, const trace_inst_t* insts, size_t n)
+{
+    for (size_t i = 0; i < n; ++i) {
+        mem_fetch(mem, insts[i].instruction_address);
+        if (insts[i].data_address != 0) mem_data(mem, insts[i].data_address);
+    }
+}
+
+void mem_print_stats(FILE* out, const mem_hier_t* mem)
+{
+    const cache_t* caches[3] = { &mem->l1i, &mem->l1d, &mem->l2 };
+    const char* names[3] = { "L1I", "L1D", "L2" };
+    for (int i = 0; i < 3; ++i) {
+        const cache_t* c = caches[i];
+        if (c->config.size == 0) continue;
+        fprintf(out, "%s: %" PRIu64 " accesses, %" PRIu64 " misses (%.2f%%)\n", names[i], c->accesses, c->misses,
+                c->accesses ? 100.0 * c->misses / c->accesses : 0.0);
+    }
+}
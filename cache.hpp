@@ -0,0 +1,73 @@
+#ifndef CACHE_HPP
+#define CACHE_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include "trace.hpp"
+
+// Set-associative cache with LRU replacement. Each set is a row of `assoc`
+// 32-bit block tags kept in recency order (most recent first), so a lookup is
+// a short scan and an update a small move; there is no separate LRU state.
+// Tag 0 marks an empty way, so tags are stored as block number + 1.
+typedef struct _cache_config_t
+{
+    uint64_t size;            // Bytes; 0 = no such cache
+    uint64_t assoc;
+    uint64_t block;           // Bytes per block (power of two)
+    uint64_t latency;         // Cycles for a hit
+} cache_config_t;
+
+typedef struct _cache_t
+{
+    cache_config_t config;
+    uint32_t block_bits;
+    uint64_t sets;
+    std::vector<uint32_t> tags;   // sets * assoc, set-major
+    uint64_t accesses;
+    uint64_t misses;
+} cache_t;
+
+// L1 instruction and data caches backed by an optional unified L2 and memory.
+// A side is modeled only if its L1 is configured; without an L2, L1 misses go
+// straight to memory.
+typedef struct _mem_config_t
+{
+    cache_config_t l1i;
+    cache_config_t l1d;
+    cache_config_t l2;
+    uint64_t mem_latency;
+} mem_config_t;
+
+typedef struct _mem_hier_t
+{
+    mem_config_t config;
+    cache_t l1i;
+    cache_t l1d;
+    cache_t l2;
+    uint64_t last_iblock;     // Block of the previous instruction fetch + 1, 0 if none
+} mem_hier_t;
+
+// No caches: instruction fetch and data accesses take no extra time
+extern const mem_config_t DEFAULT_MEM_CONFIG;
+
+// Parse "SIZE:ASSOC:BLOCK:LATENCY" (SIZE may end in k or m); false if malformed
+bool cache_parse(const char* arg, cache_config_t* config);
+
+// Reset the hierarchy to empty caches of the given configuration
+void mem_init(mem_hier_t* mem, const mem_config_t& config);
+
+// Total latency of fetching the instruction at addr. Consecutive fetches from the
+// same block count as one access.
+uint64_t mem_fetch(mem_hier_t* mem, uint32_t addr);
+
+// Total latency of a data access to addr
+uint64_t mem_data(mem_hier_t* mem, uint32_t addr);
+
+// Run the memory side of n trace instructions through the caches, without timing
+void mem_replay(mem_hier_t* mem, const trace_inst_t* insts, size_t n);
+
+// Print accesses and misses of every configured cache
+void mem_print_stats(FILE* out, const mem_hier_t* mem);
+
+#endif /* CACHE_HPP */
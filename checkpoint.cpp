@@ -0,0 +1,383 @@
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <unistd.h>
+#include "procsim.hpp"
+
+// Checkpoint file layout (all integers little-endian uint64 unless noted):
+//   magic "PSCKPT01", version
+//   R, k0, k1, k2, F, CYCLE, NEXT_TAG, DISPATCH_READY
+//   DISP_QUEUE_MAX, DISP_QUEUE_NUM, INSTR_RETIRE_NUM,
+//   MEASURE_AFTER, MEASURE_START_CYCLE, MEASURE_START_DISP_NUM, LAST_RETIRE_CYCLE,
+//   output file offset
+//   FU latencies and initiation intervals (fu_timing_t)
+//   cache configuration (mem_config_t), predictor configuration (bp_config_t)
+//   FETCH_STALL_UNTIL, whether an instruction is pending behind a fetch stall,
+//   last fetched I-block, then per cache (L1I, L1D, L2) its access and miss
+//   counts and tag array (count, then uint32s)
+//   branch predictor: BRANCH_BLOCKED, LAST_FETCHED (tag, 0 if none,
+//   UINT64_MAX if it is the pending instruction), history, update count,
+//   statistics, then the counter, tagged and site tables (count, then entries)
+//   FU_K0, FU_K1, FU_K2 busy vectors (count, then entries)
+//   event counters (count, then values), the counter log's values and cycle at
+//   its last row
+//   in-flight instructions: count, then one checkpoint_inst_t each (ROB in
+//   order, then FETCH_BUF)
+//   tag lists: FETCH_BUF, DISPATCH_Q, SCHED_Q, RETIRE_BUFFER, PREV_CYCLE_RETIRED,
+//   SCHED_Q_DELETE_BUFFER[0] (count, then tags)
+//   TIMELINE_BASE_TAG, TIMELINE window (count, then stage_record_t each)
+// Everything else (RAT, dependents, ready masks, timing wheel) is derived from
+// the above on restore. A checkpoint is taken between cycles, after the SCHED_Q deletions.
+#define CHECKPOINT_MAGIC "PSCKPT01"
+#define CHECKPOINT_VERSION 6
+
+enum {
+    CKPT_SRC_READY0   = 1 << 0,
+    CKPT_SRC_READY1   = 1 << 1,
+    CKPT_ISSUED       = 1 << 2,
+    CKPT_EXECUTED     = 1 << 3,
+    CKPT_RETIRED      = 1 << 4,
+    CKPT_JUST_RETIRED = 1 << 5,
+    CKPT_SAFE_DELETE  = 1 << 6,
+    CKPT_SCHEDULED    = 1 << 7,
+    CKPT_MISPREDICTED = 1 << 8,
+};
+
+// On-disk form of one in-flight instruction
+typedef struct _checkpoint_inst_t
+{
+    uint64_t tag;
+    uint64_t src_tag[2];
+    uint64_t cycle[6];        // fetch, dispatch, sched, exec, complete, retire
+    uint32_t instruction_address;
+    int32_t op_code;
+    int32_t src_reg[2];
+    int32_t dest_reg;
+    uint32_t flags;
+    uint32_t data_address;
+    uint32_t reserved;
+} checkpoint_inst_t;
+
+static_assert(sizeof(checkpoint_inst_t) == 104, "checkpoint_inst_t must be 104 bytes");
+
+// Helper: write/read a single uint64
+static bool put_u64(FILE* f, uint64_t v) { return fwrite(&v, sizeof(v), 1, f) == 1; }
+static bool get_u64(FILE* f, uint64_t* v) { return fread(v, sizeof(*v), 1, f) == 1; }
+
+// Helper: write a sequence of uint64 values (or tags of instructions) with its length
+template <typename C>
+static bool put_tags(FILE* f, const C& seq) {
+    bool ok = put_u64(f, seq.size());
+    for (const auto& e : seq) ok = ok && put_u64(f, e->tag);
+    return ok;
+}
+template <typename C>
+static bool put_values(FILE* f, const C& seq) {
+    bool ok = put_u64(f, seq.size());
+    for (uint64_t v : seq) ok = ok && put_u64(f, v);
+    return ok;
+}
+// Helper: write/read a table as its entry count followed by the raw entries
+template <typename T>
+static bool put_table(FILE* f, const std::vector<T>& table) {
+    return put_u64(f, table.size()) &&
+           (table.empty() || fwrite(table.data(), sizeof(T), table.size(), f) == table.size());
+}
+template <typename T>
+static bool get_table(FILE* f, std::vector<T>* table) {
+    uint64_t n;
+    return get_u64(f, &n) && n == table->size() && (n == 0 || fread(table->data(), sizeof(T), n, f) == n);
+}
+
+// Helper: append the instructions named by tags to queue; false on an unknown tag
+template <typename C>
+static bool resolve_tags(const std::vector<uint64_t>& tags,
+                         const std::unordered_map<uint64_t, proc_inst_t*>& by_tag, C* queue) {
+    for (uint64_t tag : tags) {
+        auto it = by_tag.find(tag);
+        if (it == by_tag.end()) return false;
+        queue->push_back(it->second);
+    }
+    return true;
+}
+static bool get_values(FILE* f, std::vector<uint64_t>* values) {
+    uint64_t n;
+    if (!get_u64(f, &n)) return false;
+    values->resize(n);
+    return n == 0 || fread(values->data(), sizeof(uint64_t), n, f) == n;
+}
+
+static checkpoint_inst_t encode_inst(const proc_inst_t* inst) {
+    checkpoint_inst_t rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.tag = inst->tag;
+    rec.src_tag[0] = inst->src_tag[0];
+    rec.src_tag[1] = inst->src_tag[1];
+    rec.cycle[0] = inst->fetch_cycle;
+    rec.cycle[1] = inst->dispatch_cycle;
+    rec.cycle[2] = inst->sched_cycle;
+    rec.cycle[3] = inst->exec_cycle;
+    rec.cycle[4] = inst->complete_cycle;
+    rec.cycle[5] = inst->retire_cycle;
+    rec.data_address = inst->data_address;
+    rec.instruction_address = inst->instruction_address;
+    rec.op_code = inst->op_code;
+    rec.src_reg[0] = inst->src_reg[0];
+    rec.src_reg[1] = inst->src_reg[1];
+    rec.dest_reg = inst->dest_reg;
+    rec.flags = (inst->src_ready[0] ? CKPT_SRC_READY0 : 0) | (inst->src_ready[1] ? CKPT_SRC_READY1 : 0) |
+                (inst->issued ? CKPT_ISSUED : 0) | (inst->executed ? CKPT_EXECUTED : 0) |
+                (inst->retired ? CKPT_RETIRED : 0) | (inst->just_retired ? CKPT_JUST_RETIRED : 0) |
+                (inst->safe_to_delete ? CKPT_SAFE_DELETE : 0) | (inst->scheduled ? CKPT_SCHEDULED : 0) |
+                (inst->mispredicted ? CKPT_MISPREDICTED : 0);
+    return rec;
+}
+
+static void decode_inst(const checkpoint_inst_t& rec, proc_inst_t* inst) {
+    inst->tag = rec.tag;
+    inst->src_tag[0] = rec.src_tag[0];
+    inst->src_tag[1] = rec.src_tag[1];
+    inst->fetch_cycle = rec.cycle[0];
+    inst->dispatch_cycle = rec.cycle[1];
+    inst->sched_cycle = rec.cycle[2];
+    inst->exec_cycle = rec.cycle[3];
+    inst->complete_cycle = rec.cycle[4];
+    inst->retire_cycle = rec.cycle[5];
+    inst->data_address = rec.data_address;
+    inst->instruction_address = rec.instruction_address;
+    inst->op_code = rec.op_code;
+    inst->src_reg[0] = rec.src_reg[0];
+    inst->src_reg[1] = rec.src_reg[1];
+    inst->dest_reg = rec.dest_reg;
+    inst->src_ready[0] = rec.flags & CKPT_SRC_READY0;
+    inst->src_ready[1] = rec.flags & CKPT_SRC_READY1;
+    inst->issued = rec.flags & CKPT_ISSUED;
+    inst->executed = rec.flags & CKPT_EXECUTED;
+    inst->retired = rec.flags & CKPT_RETIRED;
+    inst->just_retired = rec.flags & CKPT_JUST_RETIRED;
+    inst->safe_to_delete = rec.flags & CKPT_SAFE_DELETE;
+    inst->scheduled = rec.flags & CKPT_SCHEDULED;
+    inst->mispredicted = rec.flags & CKPT_MISPREDICTED;
+}
+
+bool proc_t::save_checkpoint(const char* path)
+{
+    uint64_t output_offset = 0;
+    if (OUTPUT_FILE.is_open()) {
+        // A binary timeline can only be resumed at a block boundary, so the rows so far form a block
+        if (OUTPUT_BINARY) timeline_flush(&TIMELINE_WRITER, OUTPUT_FILE);
+        OUTPUT_FILE.flush();
+        output_offset = OUTPUT_BINARY ? TIMELINE_WRITER.offset : static_cast<uint64_t>(OUTPUT_FILE.tellp());
+    }
+
+    std::string tmp = std::string(path) + ".tmp." + std::to_string(static_cast<long>(getpid()));
+    FILE* out = fopen(tmp.c_str(), "wb");
+    if (out == NULL) return false;
+
+    bool ok = fwrite(CHECKPOINT_MAGIC, 8, 1, out) == 1 && put_u64(out, CHECKPOINT_VERSION);
+    const uint64_t scalars[] = { PROC_R, PROC_K0, PROC_K1, PROC_K2, PROC_F, CYCLE, NEXT_TAG, DISPATCH_READY,
+                                 DISP_QUEUE_MAX, DISP_QUEUE_NUM, INSTR_RETIRE_NUM,
+                                 MEASURE_AFTER, MEASURE_START_CYCLE, MEASURE_START_DISP_NUM, LAST_RETIRE_CYCLE,
+                                 output_offset };
+    for (uint64_t v : scalars) ok = ok && put_u64(out, v);
+    ok = ok && fwrite(&FU_TIMING, sizeof(FU_TIMING), 1, out) == 1 && fwrite(&MEM_CONFIG, sizeof(MEM_CONFIG), 1, out) == 1 &&
+         fwrite(&BP_CONFIG, sizeof(BP_CONFIG), 1, out) == 1;
+    ok = ok && put_u64(out, FETCH_STALL_UNTIL) && put_u64(out, FETCH_PENDING != nullptr) &&
+         put_u64(out, MEM.last_iblock);
+    for (const cache_t* c : { &MEM.l1i, &MEM.l1d, &MEM.l2 }) {
+        ok = ok && put_u64(out, c->accesses) && put_u64(out, c->misses) && put_table(out, c->tags);
+    }
+    uint64_t last_fetched = (LAST_FETCHED == nullptr) ? 0 : (LAST_FETCHED == FETCH_PENDING) ? UINT64_MAX
+                                                                                             : LAST_FETCHED->tag;
+    ok = ok && put_u64(out, BRANCH_BLOCKED) && put_u64(out, last_fetched) && put_u64(out, BP.history) && put_u64(out, BP.updates) &&
+         put_u64(out, BP.instructions) && put_u64(out, BP.branches) && put_u64(out, BP.mispredicts) &&
+         put_table(out, BP.counters) && put_table(out, BP.tagged) && put_table(out, BP.sites);
+    ok = ok && put_values(out, FU_K0) && put_values(out, FU_K1) && put_values(out, FU_K2);
+    ok = ok && put_u64(out, NUM_COUNTERS);
+    for (int i = 0; i < NUM_COUNTERS; ++i) ok = ok && put_u64(out, COUNTERS[i]) && put_u64(out, COUNTER_LOG.last[i]);
+    ok = ok && put_u64(out, COUNTER_LOG.last_cycle);
+
+    ok = ok && put_u64(out, ROB.size() + FETCH_BUF.size());
+    std::vector<proc_inst_t*> insts = ROB.in_order();
+    insts.insert(insts.end(), FETCH_BUF.begin(), FETCH_BUF.end());
+    for (const proc_inst_t* inst : insts) {
+        checkpoint_inst_t rec = encode_inst(inst);
+        ok = ok && fwrite(&rec, sizeof(rec), 1, out) == 1;
+    }
+    ok = ok && put_tags(out, FETCH_BUF) && put_tags(out, DISPATCH_Q) && put_tags(out, SCHED_Q) &&
+         put_values(out, RETIRE_BUFFER) && put_tags(out, PREV_CYCLE_RETIRED) &&
+         put_tags(out, SCHED_Q_DELETE_BUFFER[0]);
+
+    ok = ok && put_u64(out, TIMELINE_BASE_TAG) && put_u64(out, TIMELINE.size());
+    for (const stage_record_t& rec : TIMELINE) {
+        ok = ok && fwrite(&rec, sizeof(rec), 1, out) == 1;
+    }
+
+    ok = (fclose(out) == 0) && ok;
+    // Publish atomically so a crash mid-write leaves the previous checkpoint intact
+    if (!ok || rename(tmp.c_str(), path) != 0) {
+        unlink(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool proc_t::restore_checkpoint(const char* path)
+{
+    FILE* in = fopen(path, "rb");
+    if (in == NULL) return false;
+
+    char magic[8];
+    uint64_t version = 0;
+    bool ok = fread(magic, 8, 1, in) == 1 && memcmp(magic, CHECKPOINT_MAGIC, 8) == 0 &&
+              get_u64(in, &version) && version == CHECKPOINT_VERSION;
+    uint64_t s[16];
+    for (int i = 0; ok && i < 16; ++i) ok = get_u64(in, &s[i]);
+    ok = ok && fread(&FU_TIMING, sizeof(FU_TIMING), 1, in) == 1 &&
+         fread(&MEM_CONFIG, sizeof(MEM_CONFIG), 1, in) == 1 && fread(&BP_CONFIG, sizeof(BP_CONFIG), 1, in) == 1;
+    if (!ok) {
+        fclose(in);
+        return false;
+    }
+
+    // Start from a clean instance of the saved configuration, without touching the output file
+    std::string output_path;
+    output_path.swap(OUTPUT_PATH);
+    setup(s[0], s[1], s[2], s[3], s[4]);
+    output_path.swap(OUTPUT_PATH);
+    CYCLE = s[5];
+    NEXT_TAG = s[6];
+    DISPATCH_READY = s[7];
+    DISP_QUEUE_MAX = s[8];
+    DISP_QUEUE_NUM = s[9];
+    INSTR_RETIRE_NUM = s[10];
+    MEASURE_AFTER = s[11];
+    MEASURE_START_CYCLE = s[12];
+    MEASURE_START_DISP_NUM = s[13];
+    LAST_RETIRE_CYCLE = s[14];
+    uint64_t output_offset = s[15];
+
+    uint64_t fetch_pending = 0;
+    ok = get_u64(in, &FETCH_STALL_UNTIL) && get_u64(in, &fetch_pending) && get_u64(in, &MEM.last_iblock);
+    for (cache_t* c : { &MEM.l1i, &MEM.l1d, &MEM.l2 }) {
+        ok = ok && get_u64(in, &c->accesses) && get_u64(in, &c->misses) && get_table(in, &c->tags);
+    }
+    uint64_t branch_blocked = 0, last_fetched = 0;
+    ok = ok && get_u64(in, &branch_blocked) && get_u64(in, &last_fetched) &&
+         get_u64(in, &BP.history) && get_u64(in, &BP.updates) &&
+         get_u64(in, &BP.instructions) && get_u64(in, &BP.branches) && get_u64(in, &BP.mispredicts) &&
+         get_table(in, &BP.counters) && get_table(in, &BP.tagged) && get_table(in, &BP.sites);
+    BRANCH_BLOCKED = branch_blocked;
+
+    ok = ok && get_values(in, &FU_K0) && get_values(in, &FU_K1) && get_values(in, &FU_K2) &&
+         FU_K0.size() == PROC_K0 && FU_K1.size() == PROC_K1 && FU_K2.size() == PROC_K2;
+    uint64_t num_counters = 0;
+    ok = ok && get_u64(in, &num_counters) && num_counters == NUM_COUNTERS;
+    for (int i = 0; ok && i < NUM_COUNTERS; ++i) ok = get_u64(in, &COUNTERS[i]) && get_u64(in, &COUNTER_LOG.last[i]);
+    ok = ok && get_u64(in, &COUNTER_LOG.last_cycle);
+
+    // In-flight instructions, addressed by tag while the queues are rebuilt
+    uint64_t n = 0;
+    ok = ok && get_u64(in, &n);
+    std::unordered_map<uint64_t, proc_inst_t*> by_tag;
+    std::vector<proc_inst_t*> insts;
+    for (uint64_t i = 0; ok && i < n; ++i) {
+        checkpoint_inst_t rec;
+        ok = fread(&rec, sizeof(rec), 1, in) == 1;
+        if (!ok) break;
+        proc_inst_t* inst = alloc_inst();
+        decode_inst(rec, inst);
+        by_tag[inst->tag] = inst;
+        insts.push_back(inst);
+    }
+
+    std::vector<uint64_t> tags[6];
+    for (int i = 0; ok && i < 6; ++i) ok = get_values(in, &tags[i]);
+    ok = ok && resolve_tags(tags[0], by_tag, &FETCH_BUF) && resolve_tags(tags[1], by_tag, &DISPATCH_Q) &&
+         resolve_tags(tags[2], by_tag, &SCHED_Q) && resolve_tags(tags[4], by_tag, &PREV_CYCLE_RETIRED) &&
+         resolve_tags(tags[5], by_tag, &SCHED_Q_DELETE_BUFFER[0]);
+    RETIRE_BUFFER.assign(tags[3].begin(), tags[3].end());
+    // Everything that is not still waiting in FETCH_BUF has been dispatched into the ROB
+    if (ok) insts.resize(insts.size() - FETCH_BUF.size());
+    for (proc_inst_t* inst : insts) ROB.push_back(inst);
+
+    ok = ok && get_u64(in, &TIMELINE_BASE_TAG) && get_u64(in, &n);
+    for (uint64_t i = 0; ok && i < n; ++i) {
+        stage_record_t rec;
+        ok = fread(&rec, sizeof(rec), 1, in) == 1;
+        TIMELINE.push_back(rec);
+    }
+    fclose(in);
+    if (!ok) return false;
+
+    // Derived state: the RAT holds the unretired producers in tag (ROB) order, each
+    // unready source subscribes once to its producer, and ready masks mark the
+    // scheduled, unissued instructions whose operands are both ready
+    for (proc_inst_t* inst : insts) {
+        for (int j = 0; j < 2; ++j) {
+            if (inst->src_ready[j] || (j == 1 && inst->src_tag[1] == inst->src_tag[0])) continue;
+            auto it = by_tag.find(inst->src_tag[j]);
+            if (it != by_tag.end()) it->second->dependents.push_back(inst);
+        }
+        if (!inst->retired && inst->dest_reg >= 0 && inst->dest_reg < NUM_ARCH_REGS) {
+            RAT[inst->dest_reg].push_back(inst);
+        }
+    }
+    for (proc_inst_t* inst : SCHED_Q) {
+        make_ready_if_able(inst);
+        if (inst->issued && !inst->executed) schedule_completion(inst);
+    }
+
+    // Resume the instruction source right after the last fetched instruction, and
+    // re-read the one waiting for an I-cache miss
+    if (TRACE != nullptr) {
+        if (NEXT_TAG - 1 > TRACE_LEN) return false;
+        TRACE_POS = NEXT_TAG - 1;
+    } else {
+        proc_inst_t skipped;
+        for (uint64_t i = 1; i < NEXT_TAG; ++i) {
+            if (!next_instruction(&skipped)) return false;
+        }
+    }
+    if (fetch_pending) {
+        FETCH_PENDING = alloc_inst();
+        if (!next_instruction(FETCH_PENDING)) return false;
+    }
+    if (last_fetched == UINT64_MAX) {
+        LAST_FETCHED = FETCH_PENDING;
+    } else if (last_fetched != 0) {
+        auto it = by_tag.find(last_fetched);
+        if (it == by_tag.end()) return false;
+        LAST_FETCHED = it->second;
+    }
+
+    open_output(output_offset);
+    return true;
+}
+
+bool proc_t::reconfigure(uint64_t r, uint64_t k0, uint64_t k1, uint64_t k2, uint64_t f)
+{
+    // FUs are interchangeable within a pool, so only the busy ones carry over
+    std::vector<uint64_t>* pools[3] = { &FU_K0, &FU_K1, &FU_K2 };
+    const uint64_t sizes[3] = { k0, k1, k2 };
+    std::vector<uint64_t> busy[3];
+    for (int c = 0; c < 3; ++c) {
+        for (uint64_t fu : *pools[c]) {
+            if (!fu_available(c, fu)) busy[c].push_back(fu);
+        }
+        if (busy[c].size() > sizes[c]) return false;
+    }
+    bool changed = r != PROC_R || k0 != PROC_K0 || k1 != PROC_K1 || k2 != PROC_K2 || f != PROC_F;
+    PROC_R = r;
+    PROC_K0 = k0;
+    PROC_K1 = k1;
+    PROC_K2 = k2;
+    PROC_F = f;
+    for (int c = 0; c < 3; ++c) {
+        *pools[c] = busy[c];
+        pools[c]->resize(sizes[c], 0);
+    }
+    // A forked run gets its own output, headed by the new settings
+    if (changed) open_output(0);
+    return true;
+}
@@ -0,0 +1,45 @@
+#include <cstring>
+#include "counters.hpp"
+
+const char* const COUNTER_NAMES[NUM_COUNTERS] = {
+    "cycles", "fetched", "dispatched", "scheduled", "issued_k0", "issued_k1", "issued_k2", "retired",
+    "wakeups", "stall_fetch_branch", "stall_fetch_wait", "stall_sched_full", "wait_operands", "wait_fu",
+    "fu_busy_k0", "fu_busy_k1", "fu_busy_k2", "dispatch_q_occupancy", "sched_q_occupancy", "rob_occupancy"
+};
+
+// Helper: write a uint64 to a binary log
+static void put_u64(std::ofstream& f, uint64_t v) {
+    f.write(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+bool counter_log_open(counter_log_t* log, const char* path)
+{
+    if (log->file.is_open()) log->file.close();
+    log->file.open(path, std::ios::binary | std::ios::trunc);
+    if (!log->file) return false;
+    if (log->binary) {
+        log->file.write(COUNTER_LOG_MAGIC, 8);
+        put_u64(log->file, NUM_COUNTERS);
+        for (const char* name : COUNTER_NAMES) log->file.write(name, strlen(name) + 1);
+    } else {
+        log->file << "cycle";
+        for (const char* name : COUNTER_NAMES) log->file << "," << name;
+        log->file << "\n";
+    }
+    return static_cast<bool>(log->file);
+}
+
+void counter_log_row(counter_log_t* log, const uint64_t counters[NUM_COUNTERS], uint64_t cycle)
+{
+    if (!log->file.is_open() || cycle == log->last_cycle) return;
+    if (log->binary) {
+        put_u64(log->file, cycle);
+        for (int i = 0; i < NUM_COUNTERS; ++i) put_u64(log->file, counters[i] - log->last[i]);
+    } else {
+        log->file << cycle;
+        for (int i = 0; i < NUM_COUNTERS; ++i) log->file << "," << (counters[i] - log->last[i]);
+        log->file << "\n";
+    }
+    memcpy(log->last, counters, sizeof(log->last));
+    log->last_cycle = cycle;
+}
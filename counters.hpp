@@ -0,0 +1,67 @@
+#ifndef COUNTERS_HPP
+#define COUNTERS_HPP
+
+#include <cstdint>
+#include <fstream>
+
+// Event counter registry. Every counter is a running total over the run; the
+// interval log writes the change of each counter over every N cycles.
+//
+//  events:      instructions fetched, dispatched, scheduled, issued per FU
+//               class and retired; operands woken up
+//  stalls:      cycles fetch was blocked behind a mispredicted branch or waiting
+//               for an I-cache miss or redirect; cycles the scheduling queue was
+//               full with instructions left to schedule
+//  issue waits: per cycle, scheduled unissued instructions still waiting for an
+//               operand, and ready ones left without a free FU
+//  occupancy:   per cycle, busy FUs of each class and the dispatch queue,
+//               scheduling queue and ROB sizes (divide by cycles for averages)
+enum counter_id_t
+{
+    CTR_CYCLES,
+    CTR_FETCHED,
+    CTR_DISPATCHED,
+    CTR_SCHEDULED,
+    CTR_ISSUED_K0,
+    CTR_ISSUED_K1,
+    CTR_ISSUED_K2,
+    CTR_RETIRED,
+    CTR_WAKEUPS,
+    CTR_STALL_FETCH_BRANCH,
+    CTR_STALL_FETCH_WAIT,
+    CTR_STALL_SCHED_FULL,
+    CTR_WAIT_OPERANDS,
+    CTR_WAIT_FU,
+    CTR_FU_BUSY_K0,
+    CTR_FU_BUSY_K1,
+    CTR_FU_BUSY_K2,
+    CTR_DISPATCH_Q_OCCUPANCY,
+    CTR_SCHED_Q_OCCUPANCY,
+    CTR_ROB_OCCUPANCY,
+    NUM_COUNTERS
+};
+
+extern const char* const COUNTER_NAMES[NUM_COUNTERS];
+
+#define COUNTER_LOG_MAGIC "PSSTAT01"
+
+// Interval log: CSV ("cycle,<counter names>", then one row per interval), or
+// binary (magic, counter count, the NUL-terminated names, then per interval
+// the end cycle and the counter deltas, all uint64). A row covers the cycles
+// from the previous row's cycle up to, not including, its own.
+typedef struct _counter_log_t
+{
+    uint64_t every;           // Interval length in cycles, 0 = no log
+    bool binary;
+    std::ofstream file;
+    uint64_t last[NUM_COUNTERS];  // Counter values at the previous row
+    uint64_t last_cycle;
+} counter_log_t;
+
+// Create the log file and write its header; false if it cannot be created
+bool counter_log_open(counter_log_t* log, const char* path);
+
+// Append the row for the cycles up to `cycle`
+void counter_log_row(counter_log_t* log, const uint64_t counters[NUM_COUNTERS], uint64_t cycle);
+
+#endif /* COUNTERS_HPP */
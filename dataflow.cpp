@@ -0,0 +1,141 @@
+#include <algorithm>
+#include <cinttypes>
+#include <cstdlib>
+#include <cstring>
+#include "dataflow.hpp"
+
+const uint64_t DF_DEFAULT_WINDOWS[6] = { 16, 32, 64, 128, 256, 512 };
+
+// Helper: whether r names a register, as dispatch() checks it
+static bool valid_reg(int32_t r) {
+    return r >= 0 && r < NUM_ARCH_REGS;
+}
+
+// Helper: cycles from operands ready to result for op_code; k1 takes op -1, as
+// in the pipeline, and codes no FU executes take one cycle
+static uint64_t op_latency(const dataflow_t* df, int32_t op) {
+    if (op == -1) op = 1;
+    return (op >= 0 && op <= 2) ? df->latency[op] : 1;
+}
+
+// Helper: power-of-two bucket of a slack: 0, 1, 2-3, 4-7, ...
+static int slack_bucket(uint64_t slack) {
+    int b = slack ? 64 - __builtin_clzll(slack) : 0;
+    return std::min(b, DF_SLACK_BUCKETS - 1);
+}
+
+bool dataflow_parse_windows(const char* arg, std::vector<uint64_t>* windows)
+{
+    windows->clear();
+    const char* p = arg;
+    while (true) {
+        char* end;
+        uint64_t w = strtoull(p, &end, 10);
+        if (end == p || w == 0) return false;
+        windows->push_back(w);
+        if (*end == '\0') return true;
+        if (*end != ',') return false;
+        p = end + 1;
+    }
+}
+
+void dataflow_init(dataflow_t* df, const fu_timing_t& timing, const std::vector<uint64_t>& windows)
+{
+    for (int c = 0; c < 3; ++c) df->latency[c] = timing.latency[c];
+    memset(df->reg_ready, 0, sizeof(df->reg_ready));
+    df->critical_path = 0;
+    df->instructions = 0;
+    df->windows.assign(windows.size(), df_window_t());
+    for (size_t i = 0; i < windows.size(); ++i) {
+        df_window_t& w = df->windows[i];
+        w.size = windows[i];
+        memset(w.reg_ready, 0, sizeof(w.reg_ready));
+        w.retired.assign(w.size, 0);
+        w.last_retire = 0;
+    }
+    df->pcs.clear();
+}
+
+void dataflow_replay(dataflow_t* df, const trace_inst_t* insts, size_t n)
+{
+    for (size_t i = 0; i < n; ++i) {
+        const trace_inst_t& t = insts[i];
+        uint64_t latency = op_latency(df, t.op_code);
+
+        // Unlimited window: the dataflow graph alone
+        uint64_t ready = 0;
+        for (int j = 0; j < 2; ++j) {
+            if (valid_reg(t.src_reg[j])) ready = std::max(ready, df->reg_ready[t.src_reg[j]]);
+        }
+        uint64_t complete = ready + latency;
+        if (valid_reg(t.dest_reg)) df->reg_ready[t.dest_reg] = complete;
+        uint64_t retire = std::max(complete, df->critical_path);
+        df_pc_t& pc = df->pcs[t.instruction_address];
+        pc.count++;
+        pc.growth += retire - df->critical_path;
+        pc.slack[slack_bucket(retire - complete)]++;
+        df->critical_path = retire;
+
+        // Finite windows: also wait for a slot, freed when the instruction W older retires
+        for (df_window_t& w : df->windows) {
+            uint64_t slot = df->instructions % w.size;
+            uint64_t start = (df->instructions >= w.size) ? w.retired[slot] : 0;
+            for (int j = 0; j < 2; ++j) {
+                if (valid_reg(t.src_reg[j])) start = std::max(start, w.reg_ready[t.src_reg[j]]);
+            }
+            uint64_t done = start + latency;
+            if (valid_reg(t.dest_reg)) w.reg_ready[t.dest_reg] = done;
+            w.last_retire = std::max(done, w.last_retire);
+            w.retired[slot] = w.last_retire;
+        }
+        df->instructions++;
+    }
+}
+
+void dataflow_print_stats(FILE* out, const dataflow_t* df)
+{
+    fprintf(out, "Dataflow limit (FU latency %" PRIu64 ",%" PRIu64 ",%" PRIu64 "):\n", df->latency[0],
+            df->latency[1], df->latency[2]);
+    fprintf(out, "Critical path (cycles): %" PRIu64 "\n", df->critical_path);
+    fprintf(out, "IPC limit: %.3f\n", df->critical_path ? static_cast<double>(df->instructions) / df->critical_path : 0.0);
+    if (!df->windows.empty()) {
+        fprintf(out, "  %8s %12s %9s\n", "window", "cycles", "IPC");
+        for (const df_window_t& w : df->windows) {
+            fprintf(out, "  %8" PRIu64 " %12" PRIu64 " %9.3f\n", w.size, w.last_retire,
+                    w.last_retire ? static_cast<double>(df->instructions) / w.last_retire : 0.0);
+        }
+    }
+
+    // The PCs that grew the critical path most, with how often each had how much slack
+    std::vector<std::pair<uint32_t, const df_pc_t*>> pcs;
+    for (const auto& e : df->pcs) pcs.push_back(std::make_pair(e.first, &e.second));
+    size_t shown = std::min<size_t>(pcs.size(), DF_REPORT_PCS);
+    std::partial_sort(pcs.begin(), pcs.begin() + shown, pcs.end(),
+                      [](const std::pair<uint32_t, const df_pc_t*>& a, const std::pair<uint32_t, const df_pc_t*>& b) {
+                          return a.second->growth != b.second->growth ? a.second->growth > b.second->growth
+                                                                      : a.first < b.first;
+                      });
+    fprintf(out, "Most critical PCs (critical path growth, then instances by slack):\n");
+    fprintf(out, "  %8s %10s %10s %6s", "pc", "count", "growth", "share");
+    for (int b = 0; b < DF_SLACK_BUCKETS; ++b) {
+        char label[16];
+        uint64_t lo = b ? (1ULL << (b - 1)) : 0;
+        uint64_t hi = b ? (1ULL << b) - 1 : 0;
+        if (b == DF_SLACK_BUCKETS - 1) {
+            snprintf(label, sizeof(label), "%" PRIu64 "+", lo);
+        } else if (lo == hi) {
+            snprintf(label, sizeof(label), "%" PRIu64, lo);
+        } else {
+            snprintf(label, sizeof(label), "%" PRIu64 "-%" PRIu64, lo, hi);
+        }
+        fprintf(out, " %8s", label);
+    }
+    fprintf(out, "\n");
+    for (size_t i = 0; i < shown && pcs[i].second->growth > 0; ++i) {
+        const df_pc_t* pc = pcs[i].second;
+        fprintf(out, "  %8x %10" PRIu64 " %10" PRIu64 " %5.1f%%", pcs[i].first, pc->count, pc->growth,
+                df->critical_path ? 100.0 * pc->growth / df->critical_path : 0.0);
+        for (int b = 0; b < DF_SLACK_BUCKETS; ++b) fprintf(out, " %8" PRIu64, pc->slack[b]);
+        fprintf(out, "\n");
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef DATAFLOW_HPP
+#define DATAFLOW_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <unordered_map>
+#include <vector>
+#include "procsim.hpp"
+#include "trace.hpp"
+
+// Dataflow limit analysis of a trace, in one pass and without the pipeline. Only
+// true dependences through the NUM_ARCH_REGS registers count, as in dispatch();
+// renaming removes the rest. An instruction completes the latency of its FU
+// class (--fu-latency) after its last operand is ready, with unlimited FUs,
+// fetch bandwidth and result buses.
+//
+//  critical path: the longest latency-weighted dependence chain. Instructions
+//                 over its length bound IPC on any such machine.
+//  windows:       the same bound when at most W consecutive instructions are in
+//                 flight: one enters when the instruction W older has retired,
+//                 and instructions retire in order.
+//  criticality:   with no window limit an instruction "retires" at the latest
+//                 completion of any instruction up to it. Its slack is the gap
+//                 from its own completion; at slack 0 it ends the longest chain
+//                 so far, and what it adds to the retire time is the growth of
+//                 the critical path it causes. Growth is summed per PC, and
+//                 slacks are counted per PC in power-of-two buckets.
+//
+// Memory is a ready time per register and model, W retire times per window
+// and one record per distinct PC, however long the trace.
+
+#define DF_SLACK_BUCKETS 8     // 0, 1, 2-3, 4-7, ..., 64 and above
+#define DF_REPORT_PCS 20       // PCs listed by dataflow_print_stats()
+
+// One window size of the limit study
+typedef struct _df_window_t
+{
+    uint64_t size;
+    uint64_t reg_ready[NUM_ARCH_REGS];
+    std::vector<uint64_t> retired;        // Retire times of the last `size` instructions, a ring
+    uint64_t last_retire;
+} df_window_t;
+
+// Criticality of one static instruction
+typedef struct _df_pc_t
+{
+    uint64_t count;
+    uint64_t growth;                      // Cycles of critical path growth at this PC
+    uint64_t slack[DF_SLACK_BUCKETS];
+} df_pc_t;
+
+typedef struct _dataflow_t
+{
+    uint64_t latency[3];
+    uint64_t reg_ready[NUM_ARCH_REGS];    // Unlimited window: completion of each register's producer
+    uint64_t critical_path;               // Latest completion so far
+    uint64_t instructions;
+    std::vector<df_window_t> windows;
+    std::unordered_map<uint32_t, df_pc_t> pcs;
+} dataflow_t;
+
+// Window sizes studied by default
+extern const uint64_t DF_DEFAULT_WINDOWS[6];
+
+// Parse "W1,W2,..." (each at least 1) into window sizes; false if malformed
+bool dataflow_parse_windows(const char* arg, std::vector<uint64_t>* windows);
+
+// Start an empty analysis with the FU latencies of timing and the given windows
+void dataflow_init(dataflow_t* df, const fu_timing_t& timing, const std::vector<uint64_t>& windows);
+
+// Add n trace instructions to the dependence graph
+void dataflow_replay(dataflow_t* df, const trace_inst_t* insts, size_t n);
+
+// Print the critical path, the IPC limit per window and the most critical PCs
+void dataflow_print_stats(FILE* out, const dataflow_t* df);
+
+#endif /* DATAFLOW_HPP */
@@ -0,0 +1,153 @@
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include "multicore.hpp"
+
+// Sense-reversing spin barrier. The last thread to arrive runs the completion
+// step alone, before any thread is released, so the step sees the work of every
+// thread and every thread sees its result.
+typedef struct _mc_barrier_t
+{
+    unsigned count;
+    std::atomic<unsigned> waiting;
+    std::atomic<unsigned> phase;
+} mc_barrier_t;
+
+// State of one multicore run, shared by the worker threads
+typedef struct _multicore_t
+{
+    const std::vector<proc_t*>* cores;
+    mem_hier_t* shared_mem;
+    unsigned nthreads;
+    std::vector<char> done;       // Core i has drained
+    uint64_t cycle;
+    bool finished;
+    std::vector<uint32_t> free_fus;
+    mc_barrier_t barrier;
+} multicore_t;
+
+template <typename Step>
+static void barrier_wait(mc_barrier_t* b, Step step) {
+    unsigned phase = b->phase.load(std::memory_order_acquire);
+    if (b->waiting.fetch_add(1, std::memory_order_acq_rel) + 1 == b->count) {
+        step();
+        b->waiting.store(0, std::memory_order_relaxed);
+        b->phase.store(phase + 1, std::memory_order_release);
+        return;
+    }
+    for (unsigned spins = 0; b->phase.load(std::memory_order_acquire) == phase; ++spins) {
+        if (spins >= 1024) std::this_thread::yield();
+    }
+}
+
+// Helper: hand out the FUs free in this cycle (free in every core's view) in index
+// order: each core in turn, from the one whose turn it is, takes as many as it has
+// ready instructions of the class
+static void grant_fus(multicore_t* mc) {
+    const std::vector<proc_t*>& cores = *mc->cores;
+    size_t n = cores.size();
+    const fu_timing_t& timing = cores[0]->FU_TIMING;
+    for (int c = 0; c < 3; ++c) {
+        mc->free_fus.clear();
+        size_t pool = (c == 0) ? cores[0]->FU_K0.size() : (c == 1) ? cores[0]->FU_K1.size() : cores[0]->FU_K2.size();
+        for (size_t i = 0; i < pool; ++i) {
+            bool available = true;
+            for (proc_t* core : cores) {
+                uint64_t fu = (c == 0) ? core->FU_K0[i] : (c == 1) ? core->FU_K1[i] : core->FU_K2[i];
+                available = available && (timing.interval[c] ? fu <= mc->cycle : fu == 0);
+            }
+            if (available) mc->free_fus.push_back(static_cast<uint32_t>(i));
+        }
+        size_t next = 0;
+        for (size_t k = 0; k < n; ++k) {
+            size_t i = (mc->cycle + k) % n;
+            cores[i]->FU_GRANT[c].clear();
+            if (mc->done[i]) continue;
+            size_t want = cores[i]->SCHED_Q.ready_count(c);
+            for (; want > 0 && next < mc->free_fus.size(); --want) {
+                cores[i]->FU_GRANT[c].push_back(mc->free_fus[next++]);
+            }
+        }
+    }
+}
+
+// Helper: the second phase of core i's cycle: issue, and the front of its pipeline
+static void run_back_end(multicore_t* mc, size_t i) {
+    proc_t* core = (*mc->cores)[i];
+    core->execute();
+    core->schedule();
+    if (core->DISPATCH_READY) core->dispatch();
+    core->fetch();
+    core->DISPATCH_READY = true;
+    if (core->end_cycle()) mc->done[i] = 1;
+}
+
+static void multicore_worker(multicore_t* mc, unsigned self) {
+    size_t n = mc->cores->size();
+    while (true) {
+        for (size_t i = self; i < n; i += mc->nthreads) {
+            if (!mc->done[i]) (*mc->cores)[i]->update();
+        }
+        barrier_wait(&mc->barrier, [mc, n]() {
+            grant_fus(mc);
+            if (mc->shared_mem == nullptr) return;
+            for (size_t k = 0; k < n; ++k) {
+                size_t i = (mc->cycle + k) % n;
+                if (!mc->done[i]) run_back_end(mc, i);
+            }
+        });
+        if (mc->shared_mem == nullptr) {
+            for (size_t i = self; i < n; i += mc->nthreads) {
+                if (!mc->done[i]) run_back_end(mc, i);
+            }
+        }
+        barrier_wait(&mc->barrier, [mc]() {
+            mc->finished = true;
+            for (char d : mc->done) mc->finished = mc->finished && d;
+            mc->cycle++;
+        });
+        if (mc->finished) break;
+    }
+}
+
+void multicore_run(const std::vector<proc_t*>& cores, mem_hier_t* shared_mem, unsigned nthreads,
+                   std::vector<proc_stats_t>* stats)
+{
+    if (nthreads == 0) nthreads = std::thread::hardware_concurrency();
+    if (nthreads == 0 || nthreads > cores.size()) nthreads = cores.size();
+
+    multicore_t* mc = new multicore_t();
+    mc->cores = &cores;
+    mc->shared_mem = shared_mem;
+    mc->nthreads = nthreads;
+    mc->done.assign(cores.size(), 0);
+    mc->cycle = cores[0]->CYCLE;
+    mc->finished = false;
+    mc->barrier.count = nthreads;
+    mc->barrier.waiting = 0;
+    mc->barrier.phase = 0;
+    for (proc_t* core : cores) {
+        core->SHARED_FUS = true;
+        core->MEM_SHARED = shared_mem;
+        // Cores advance together, so none may jump ahead over its idle cycles
+        core->SKIP_IDLE = false;
+        core->PROGRESS = false;
+    }
+
+    std::vector<std::thread> workers;
+    for (unsigned t = 1; t < nthreads; ++t) {
+        workers.push_back(std::thread(multicore_worker, mc, t));
+    }
+    multicore_worker(mc, 0);
+    for (auto& w : workers) {
+        w.join();
+    }
+    delete mc;
+
+    stats->assign(cores.size(), proc_stats_t());
+    for (size_t i = 0; i < cores.size(); ++i) {
+        memset(&(*stats)[i], 0, sizeof(proc_stats_t));
+        (*stats)[i].cycle_count = cores[i]->CYCLE;
+        (*stats)[i].retired_instruction = cores[i]->INSTR_RETIRE_NUM;
+    }
+}
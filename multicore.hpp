@@ -0,0 +1,30 @@
+#ifndef MULTICORE_HPP
+#define MULTICORE_HPP
+
+#include <cstdint>
+#include <vector>
+#include "cache.hpp"
+#include "procsim.hpp"
+
+// Multicore / SMT model: one trace per core, each core with its own fetch,
+// queues, ROB and branch predictor, all running in lockstep over one pool of
+// k0/k1/k2 FUs and optionally one cache hierarchy.
+//
+// Every cycle has two phases, each ended by a barrier. First every core retires
+// and wakes up dependents (update). Then the free FUs of each class are handed
+// out in index order to the cores' ready instructions, the core served first
+// rotating every cycle, and every core issues to its grant and runs the rest of
+// its pipeline. Cores are spread over host threads; without a shared cache both
+// phases run in parallel. With one, the second phase runs core by core in the
+// same rotating order, so the cache sees a fixed access order. Results never
+// depend on the number of threads, and a single core matches a plain run.
+
+// Simulate cores[i] until every one has drained. Every core must be set up with
+// the same FU counts and have its trace attached; shared_mem, if not null, is the
+// cache hierarchy they all use instead of their own. nthreads = 0 runs one thread
+// per core, up to one per hardware thread. stats[i] receives the cycle and
+// instruction counts of core i, to be completed by proc_t::complete().
+void multicore_run(const std::vector<proc_t*>& cores, mem_hier_t* shared_mem, unsigned nthreads,
+                   std::vector<proc_stats_t>* stats);
+
+#endif /* MULTICORE_HPP */
@@ -0,0 +1,140 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include "partition.hpp"
+
+// Measured part of one chunk
+typedef struct _chunk_result_t
+{
+    uint64_t cycles;          // From the retirement before the chunk to its last one
+    uint64_t tail;            // Cycles from the last retirement to the end of the run
+    uint64_t disp_num;
+    uint64_t disp_max;
+} chunk_result_t;
+
+// Jobs of a run: chunk i is job i, the serial check (if any) job `chunks`
+typedef struct _partition_jobs_t
+{
+    const trace_inst_t* trace;
+    size_t trace_len;
+    const partition_params_t* params;
+    uint64_t config[5];       // r, k0, k1, k2, f
+    const proc_t* model;
+    std::atomic<size_t> next;
+    size_t count;
+    std::vector<chunk_result_t> chunks;
+    proc_stats_t serial;
+} partition_jobs_t;
+
+bool partition_parse(const char* arg, partition_params_t* params)
+{
+    memset(params, 0, sizeof(*params));
+    char* end;
+    params->chunks = strtoull(arg, &end, 10);
+    if (end == arg || params->chunks == 0) return false;
+    if (*end == ':') {
+        const char* p = end + 1;
+        params->warmup = strtoull(p, &end, 10);
+        if (end == p) return false;
+    }
+    return *end == '\0';
+}
+
+// Helper: simulate chunk i of the trace
+static void simulate_chunk(proc_t* proc, partition_jobs_t* jobs, size_t i) {
+    uint64_t chunks = jobs->params->chunks;
+    uint64_t begin = jobs->trace_len * i / chunks;
+    uint64_t end = jobs->trace_len * (i + 1) / chunks;
+    uint64_t warm = std::min<uint64_t>(jobs->params->warmup, begin);
+    proc->TRACE = jobs->trace + (begin - warm);
+    proc->TRACE_LEN = end - begin + warm;
+    proc->MEASURE_AFTER = warm;
+    proc->setup(jobs->config[0], jobs->config[1], jobs->config[2], jobs->config[3], jobs->config[4]);
+    proc_stats_t stats;
+    memset(&stats, 0, sizeof(stats));
+    proc->run(&stats);
+
+    // Without warmup the chunk runs from cycle 0, like a full run
+    chunk_result_t& res = jobs->chunks[i];
+    res.cycles = warm ? proc->LAST_RETIRE_CYCLE - proc->MEASURE_START_CYCLE : proc->LAST_RETIRE_CYCLE + 1;
+    res.tail = proc->CYCLE - proc->LAST_RETIRE_CYCLE - 1;
+    res.disp_num = proc->DISP_QUEUE_NUM - (warm ? proc->MEASURE_START_DISP_NUM : 0);
+    res.disp_max = proc->DISP_QUEUE_MAX;
+}
+
+static void partition_worker(partition_jobs_t* jobs) {
+    proc_t* proc = new proc_t();
+    proc->copy_model(*jobs->model);
+    proc->OUTPUT_PATH.clear();
+    proc->PROGRESS = false;
+    size_t job;
+    while ((job = jobs->next.fetch_add(1)) < jobs->count) {
+        // The serial run is the longest, so it is handed out first
+        if (jobs->params->check && job == 0) {
+            proc->TRACE = jobs->trace;
+            proc->TRACE_LEN = jobs->trace_len;
+            proc->MEASURE_AFTER = 0;
+            proc->setup(jobs->config[0], jobs->config[1], jobs->config[2], jobs->config[3], jobs->config[4]);
+            memset(&jobs->serial, 0, sizeof(jobs->serial));
+            proc->run(&jobs->serial);
+            proc->finish_stats(&jobs->serial);
+            continue;
+        }
+        simulate_chunk(proc, jobs, jobs->params->check ? job - 1 : job);
+    }
+    delete proc;
+}
+
+bool partition_run(const trace_inst_t* trace, size_t trace_len, const partition_params_t& params,
+                   uint64_t r, uint64_t k0, uint64_t k1, uint64_t k2, uint64_t f,
+                   const proc_t& model, unsigned nthreads, partition_result_t* result)
+{
+    memset(result, 0, sizeof(*result));
+    if (trace_len < params.chunks) return false;
+
+    partition_jobs_t jobs;
+    jobs.trace = trace;
+    jobs.trace_len = trace_len;
+    jobs.params = &params;
+    const uint64_t config[5] = { r, k0, k1, k2, f };
+    std::copy(config, config + 5, jobs.config);
+    jobs.model = &model;
+    jobs.next = 0;
+    jobs.count = params.chunks + (params.check ? 1 : 0);
+    jobs.chunks.assign(params.chunks, chunk_result_t());
+
+    if (nthreads == 0) nthreads = std::thread::hardware_concurrency();
+    if (nthreads == 0) nthreads = 1;
+    if (nthreads > jobs.count) nthreads = jobs.count;
+    std::vector<std::thread> workers;
+    for (unsigned t = 1; t < nthreads; ++t) {
+        workers.push_back(std::thread(partition_worker, &jobs));
+    }
+    partition_worker(&jobs);
+    for (auto& w : workers) {
+        w.join();
+    }
+
+    // Stitch the chunks: the run ends as the last one does
+    uint64_t cycles = jobs.chunks.back().tail;
+    uint64_t disp_num = 0;
+    proc_stats_t& s = result->stats;
+    for (const chunk_result_t& c : jobs.chunks) {
+        cycles += c.cycles;
+        disp_num += c.disp_num;
+        s.max_disp_size = std::max<unsigned long>(s.max_disp_size, c.disp_max);
+    }
+    for (uint64_t i = 0; i < params.chunks; ++i) {
+        result->detailed_instructions += trace_len * (i + 1) / params.chunks - trace_len * i / params.chunks +
+                                         std::min<uint64_t>(params.warmup, trace_len * i / params.chunks);
+    }
+    s.cycle_count = cycles;
+    s.retired_instruction = trace_len;
+    s.avg_disp_size = static_cast<double>(disp_num) / (cycles - 1);
+    s.avg_inst_fired = static_cast<double>(trace_len) / (cycles - 1);
+    s.avg_inst_retired = s.avg_inst_fired;
+    result->serial = jobs.serial;
+    return true;
+}
@@ -0,0 +1,42 @@
+#ifndef PARTITION_HPP
+#define PARTITION_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include "procsim.hpp"
+
+// Parallel simulation by trace partitioning. The decoded trace is cut into
+// `chunks` consecutive pieces of equal length that are simulated concurrently,
+// each from an empty pipeline, after up to `warmup` unmeasured instructions
+// from just before it. The measured pieces are stitched together: their cycles
+// and dispatch queue occupancy add up, and the largest dispatch queue is the
+// largest of any piece. Caches and predictor tables start cold in every piece,
+// and warmup cannot rebuild a backlog that grew over everything before it, so
+// the result is an estimate; with `check` the serial run goes alongside and the
+// error of every statistic is reported.
+
+typedef struct _partition_params_t
+{
+    uint64_t chunks;
+    uint64_t warmup;          // Unmeasured instructions before each chunk
+    bool check;               // Also run the whole trace serially
+} partition_params_t;
+
+typedef struct _partition_result_t
+{
+    proc_stats_t stats;               // Stitched estimate
+    uint64_t detailed_instructions;   // Simulated in the chunks, warmup included
+    proc_stats_t serial;              // Serial run, if checked
+} partition_result_t;
+
+// Parse "K[:W]"; false if malformed
+bool partition_parse(const char* arg, partition_params_t* params);
+
+// Simulate configuration (r, k0, k1, k2, f) with the model settings of `model`
+// on nthreads worker threads (0 = one per hardware thread); false if the trace
+// has fewer instructions than chunks
+bool partition_run(const trace_inst_t* trace, size_t trace_len, const partition_params_t& params,
+                   uint64_t r, uint64_t k0, uint64_t k1, uint64_t k2, uint64_t f,
+                   const proc_t& model, unsigned nthreads, partition_result_t* result);
+
+#endif /* PARTITION_HPP */
@@ -1,6 +1,7 @@
 #include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <deque>
-std::deque<uint64_t> RETIRE_BUFFER;
 #include <iostream>
 #include "procsim.hpp"
 #include <deque>
@@ -10,41 +11,129 @@ std::deque<uint64_t> RETIRE_BUFFER;
 #include <set>
 #include <fstream>
 #include <iomanip>
+#include <unistd.h>
 
 #define DEBUG_LEVEL 0  // 0 = no debug, 1 = essential debug, 2 = verbose
 
-// --- Tomasulo Global Variables ---
-
-// Persistent dispatch ready flag for one-cycle delay between fetch and dispatch
-bool DISPATCH_READY = false;
-
-uint64_t PROC_R = 0, PROC_K0 = 0, PROC_K1 = 0, PROC_K2 = 0, PROC_F = 0;
-uint64_t CYCLE = 0;
-uint64_t NEXT_TAG = 1;
-std::deque<proc_inst_t*> ROB;
-std::deque<proc_inst_t*> DISPATCH_Q;
-std::deque<proc_inst_t*> SCHED_Q;
-// FETCH buffer for fetched but not yet dispatched instructions
-std::deque<proc_inst_t*> FETCH_BUF;
-std::unordered_set<uint64_t> RESULT_TAGS;
-// Delayed result broadcast for Tomasulo: tags that will be broadcast next cycle
-std::unordered_set<uint64_t> BROADCAST_TAGS;
-std::unordered_map<uint64_t, std::vector<uint64_t>> STAGE_TRACKER;
-std::vector<uint64_t> FU_K0, FU_K1, FU_K2;
-uint64_t DISP_QUEUE_MAX = 0;
-uint64_t DISP_QUEUE_NUM = 0;
-uint64_t INSTR_RETIRE_NUM = 0;
+// Processor instance behind setup_proc()/run_proc()/complete_proc()
+proc_t PROC;
+
+const fu_timing_t DEFAULT_FU_TIMING = { { 1, 1, 1 }, { 0, 0, 0 } };
+
+proc_t::proc_t()
+    : PROC_R(0), PROC_K0(0), PROC_K1(0), PROC_K2(0), PROC_F(0),
+      CYCLE(0), NEXT_TAG(1), DISPATCH_READY(false),
+      TIMELINE_BASE_TAG(1), OUTPUT_PATH("result_test.output"), OUTPUT_BINARY(false),
+      FU_TIMING(DEFAULT_FU_TIMING), WHEEL_MASK(0), WHEEL_PENDING(0),
+      MEM_CONFIG(DEFAULT_MEM_CONFIG), FETCH_STALL_UNTIL(0), FETCH_PENDING(nullptr),
+      BP_CONFIG(DEFAULT_BP_CONFIG), BRANCH_BLOCKED(false), LAST_FETCHED(nullptr),
+      SHARED_FUS(false), MEM_SHARED(nullptr),
+      DISP_QUEUE_MAX(0), DISP_QUEUE_NUM(0), INSTR_RETIRE_NUM(0),
+      TRACE(nullptr), TRACE_LEN(0), TRACE_POS(0), TRACE_DONE(false), SKIP_IDLE(true), IDLE_CYCLES_SKIPPED(0), PROGRESS(true),
+      MEASURE_AFTER(0), MEASURE_START_CYCLE(0), MEASURE_START_DISP_NUM(0), LAST_RETIRE_CYCLE(0),
+      CHECKPOINT_EVERY(0), CHECKPOINT_AT(0), STOPPED(false)
+{
+    PROFILE.enabled = false;
+    profile_reset(&PROFILE);
+    COUNTER_LOG.every = 0;
+    COUNTER_LOG.binary = false;
+}
+
+void proc_t::copy_model(const proc_t& other)
+{
+    FU_TIMING = other.FU_TIMING;
+    MEM_CONFIG = other.MEM_CONFIG;
+    BP_CONFIG = other.BP_CONFIG;
+    SKIP_IDLE = other.SKIP_IDLE;
+}
 
 // Helper: get FU vector for op_code
 // Treat op == -1 as equivalent to op == 1 (k1), per assignment spec
-static std::vector<uint64_t>* get_fu_vec(int32_t op) {
+std::vector<uint64_t>* proc_t::get_fu_vec(int32_t op) {
     if (op == -1 || op == 1) return &FU_K1;
     if (op == 0) return &FU_K0;
     if (op == 2) return &FU_K2;
     return nullptr;
 }
 
-void setup_proc(uint64_t r, uint64_t k0, uint64_t k1, uint64_t k2, uint64_t f)
+// Helper: FU class (0, 1, 2) for op_code, or -1 if no FU can execute it
+static int fu_class(int32_t op) {
+    if (op == -1) op = 1;
+    return (op >= 0 && op <= 2) ? op : -1;
+}
+
+// Helper: whether an FU of class cls with status fu can accept an operation this cycle
+bool proc_t::fu_available(int cls, uint64_t fu) const {
+    return FU_TIMING.interval[cls] ? fu <= CYCLE : fu == 0;
+}
+
+// Helper: queue an issued multi-cycle operation for completion on the timing wheel
+void proc_t::schedule_completion(proc_inst_t* inst) {
+    WHEEL[inst->complete_cycle & WHEEL_MASK].push_back(inst);
+    WHEEL_PENDING++;
+}
+
+// Helper: inst has produced its result this cycle. If it is a mispredicted branch,
+// fetch restarts on the right path after the redirect penalty.
+void proc_t::on_complete(proc_inst_t* inst) {
+    inst->executed = true;
+    THIS_CYCLE_TAGS.push_back(inst->tag);
+    if (inst->mispredicted) {
+        BRANCH_BLOCKED = false;
+        FETCH_STALL_UNTIL = std::max(FETCH_STALL_UNTIL, CYCLE + 1 + BP_CONFIG.penalty);
+    }
+}
+
+// Helper: mark inst ready in its class mask once it sits in SCHED_Q with both operands ready
+void proc_t::make_ready_if_able(proc_inst_t* inst) {
+    if (!inst->scheduled || inst->issued) return;
+    if (!(inst->src_ready[0] && inst->src_ready[1])) return;
+    int cls = fu_class(inst->op_code);
+    if (cls >= 0) SCHED_Q.set_ready(SCHED_Q.find(inst->tag), cls);
+}
+
+// Helper: take an instruction slot from the pool, growing it only if no retired
+// slot is free. Elements of a std::deque never move, so handed-out pointers stay valid.
+proc_inst_t* proc_t::alloc_inst() {
+    uint32_t slot;
+    if (INST_FREE_SLOTS.empty()) {
+        slot = static_cast<uint32_t>(INST_POOL.size());
+        INST_POOL.push_back(proc_inst_t());
+    } else {
+        slot = INST_FREE_SLOTS.back();
+        INST_FREE_SLOTS.pop_back();
+    }
+    proc_inst_t* inst = &INST_POOL[slot];
+    // Reset the slot but keep the dependents list's capacity for reuse
+    std::vector<proc_inst_t*> dependents;
+    dependents.swap(inst->dependents);
+    *inst = proc_inst_t();
+    inst->slot = slot;
+    inst->dependents.swap(dependents);
+    inst->dependents.clear();
+    return inst;
+}
+
+// Helper: return an instruction's slot to the pool
+void proc_t::free_inst(proc_inst_t* inst) {
+    INST_FREE_SLOTS.push_back(inst->slot);
+}
+
+// Helper: next trace instruction, from the shared decoded trace when one is attached
+bool proc_t::next_instruction(proc_inst_t* p_inst) {
+    if (TRACE == nullptr) return read_instruction(p_inst);
+    if (TRACE_POS >= TRACE_LEN) return false;
+    const trace_inst_t& t = TRACE[TRACE_POS++];
+    p_inst->instruction_address = t.instruction_address;
+    p_inst->op_code = t.op_code;
+    p_inst->dest_reg = t.dest_reg;
+    p_inst->src_reg[0] = t.src_reg[0];
+    p_inst->src_reg[1] = t.src_reg[1];
+    p_inst->data_address = t.data_address;
+    return true;
+}
+
+void proc_t::setup(uint64_t r, uint64_t k0, uint64_t k1, uint64_t k2, uint64_t f)
 {
     PROC_R = r;
     PROC_K0 = k0;
@@ -53,44 +142,156 @@ void setup_proc(uint64_t r, uint64_t k0, uint64_t k1, uint64_t k2, uint64_t f)
     PROC_F = f;
     CYCLE = 0;
     NEXT_TAG = 1;
-    for (auto ptr : ROB) {
-        delete ptr;
-    }
+    DISPATCH_READY = false;
+    TRACE_POS = 0;
+    TRACE_DONE = false;
+    IDLE_CYCLES_SKIPPED = 0;
     ROB.clear();
-    for (auto ptr : DISPATCH_Q) {
-        delete ptr;
-    }
     DISPATCH_Q.clear();
-    for (auto ptr : SCHED_Q) {
-        delete ptr;
-    }
     SCHED_Q.clear();
-    RESULT_TAGS.clear();
-    STAGE_TRACKER.clear();
+    FETCH_BUF.clear();
+    RETIRE_BUFFER.clear();
+    INST_POOL.clear();
+    INST_FREE_SLOTS.clear();
+    TIMELINE.clear();
+    TIMELINE_BASE_TAG = 1;
+    RAT.assign(NUM_ARCH_REGS, std::deque<proc_inst_t*>());
+    mem_init(&MEM, MEM_CONFIG);
+    FETCH_STALL_UNTIL = 0;
+    FETCH_PENDING = nullptr;
+    bp_init(&BP, BP_CONFIG);
+    BRANCH_BLOCKED = false;
+    LAST_FETCHED = nullptr;
+    // The longest operation is the slowest FU plus a data access that misses everywhere
+    uint64_t max_latency = 1;
+    for (int c = 0; c < 3; ++c) max_latency = std::max(max_latency, FU_TIMING.latency[c]);
+    if (MEM_CONFIG.l1d.size) max_latency += MEM_CONFIG.l1d.latency + MEM_CONFIG.l2.latency + MEM_CONFIG.mem_latency;
+    uint64_t wheel_size = 1;
+    while (wheel_size < max_latency) wheel_size <<= 1;
+    WHEEL.assign(wheel_size, std::vector<proc_inst_t*>());
+    WHEEL_MASK = wheel_size - 1;
+    WHEEL_PENDING = 0;
     FU_K0 = std::vector<uint64_t>(k0, 0);
     FU_K1 = std::vector<uint64_t>(k1, 0);
     FU_K2 = std::vector<uint64_t>(k2, 0);
     DISP_QUEUE_MAX = 0;
     DISP_QUEUE_NUM = 0;
     INSTR_RETIRE_NUM = 0;
-    // No exec_cycle to initialize
+    MEASURE_START_CYCLE = 0;
+    MEASURE_START_DISP_NUM = 0;
+    LAST_RETIRE_CYCLE = 0;
+    THIS_CYCLE_TAGS.clear();
+    PREV_CYCLE_RETIRED.clear();
+    THIS_CYCLE_RETIRED.clear();
+    SCHED_Q_DELETE_BUFFER[0].clear();
+    SCHED_Q_DELETE_BUFFER[1].clear();
+    STOPPED = false;
+    memset(COUNTERS, 0, sizeof(COUNTERS));
+    memset(COUNTER_LOG.last, 0, sizeof(COUNTER_LOG.last));
+    COUNTER_LOG.last_cycle = 0;
+    profile_reset(&PROFILE);
+    open_output(0);
 }
 
-// // Helper: instruction latency by op_code
-// static int instr_latency(int32_t op) {
-//     if (op == 0) return 1; // k0
-//     if (op == 1) return 1; // k1
-//     if (op == 2) return 1; // k2
-//     return 1;
-// }
+// Helper: open the output file. Settings and the timeline header go out first;
+// timeline rows follow as instructions retire and complete() appends the stats.
+// A nonzero resume_offset continues an existing file (after a checkpoint restore)
+// from that byte, if the file is at least that long.
+void proc_t::open_output(uint64_t resume_offset)
+{
+    if (OUTPUT_FILE.is_open()) OUTPUT_FILE.close();
+    if (OUTPUT_PATH.empty()) return;
+    std::ios::openmode mode = OUTPUT_BINARY ? std::ios::binary : std::ios::openmode();
+    if (resume_offset > 0) {
+        std::ifstream existing(OUTPUT_PATH.c_str(), std::ios::binary | std::ios::ate);
+        if (existing && static_cast<uint64_t>(existing.tellg()) >= resume_offset &&
+            (!OUTPUT_BINARY || timeline_resume(&TIMELINE_WRITER, OUTPUT_PATH.c_str(), resume_offset)) &&
+            truncate(OUTPUT_PATH.c_str(), resume_offset) == 0) {
+            OUTPUT_FILE.open(OUTPUT_PATH.c_str(), std::ios::out | std::ios::app | mode);
+            return;
+        }
+    }
+    OUTPUT_FILE.open(OUTPUT_PATH.c_str(), std::ios::out | std::ios::trunc | mode);
+    if (OUTPUT_BINARY) {
+        const uint64_t settings[5] = { PROC_R, PROC_K0, PROC_K1, PROC_K2, PROC_F };
+        timeline_write_header(&TIMELINE_WRITER, OUTPUT_FILE, settings);
+        return;
+    }
+    auto out_setting = [&](const char* name, uint64_t val) { OUTPUT_FILE << name << ": " << val << "\n"; };
+    OUTPUT_FILE << "Processor Settings\n";
+    out_setting("R", PROC_R);
+    out_setting("k0", PROC_K0);
+    out_setting("k1", PROC_K1);
+    out_setting("k2", PROC_K2);
+    out_setting("F", PROC_F);
+    OUTPUT_FILE << "\n";
+    OUTPUT_FILE << "INST\tFETCH\tDISP\tSCHED\tEXEC\tSTATE\n";
+}
 
-void fetch() {
+// Helper: record a retired instruction in the timeline and write out every row
+// whose older tags have all retired, keeping the output in tag order
+void proc_t::record_timeline(const proc_inst_t* inst) {
+    if (!OUTPUT_FILE.is_open()) return;
+    uint64_t idx = inst->tag - TIMELINE_BASE_TAG;
+    if (idx >= TIMELINE.size()) TIMELINE.resize(idx + 1);
+    stage_record_t& rec = TIMELINE[idx];
+    rec.stage[0] = inst->fetch_cycle;
+    rec.stage[1] = inst->dispatch_cycle;
+    rec.stage[2] = inst->sched_cycle;
+    rec.stage[3] = inst->exec_cycle;
+    rec.stage[4] = inst->retire_cycle;
+    rec.retired = true;
+    while (!TIMELINE.empty() && TIMELINE.front().retired) {
+        const stage_record_t& front = TIMELINE.front();
+        if (OUTPUT_BINARY) {
+            timeline_add(&TIMELINE_WRITER, OUTPUT_FILE, TIMELINE_BASE_TAG, front.stage);
+        } else {
+            OUTPUT_FILE << TIMELINE_BASE_TAG;
+            for (int j = 0; j < 5; ++j) {
+                OUTPUT_FILE << "\t" << (front.stage[j] + 1);
+            }
+            OUTPUT_FILE << "\n";
+        }
+        TIMELINE.pop_front();
+        TIMELINE_BASE_TAG++;
+    }
+}
+
+template <uint64_t F>
+void proc_t::fetch_stage() {
     // Only fetch instructions from the trace and store in FETCH_BUF.
-    for (uint64_t i = 0; i < PROC_F; ++i) {
-        proc_inst_t* inst = new proc_inst_t();
-        if (!read_instruction(inst)) {
-            delete inst;
-            continue;
+    if (BRANCH_BLOCKED || CYCLE < FETCH_STALL_UNTIL) {
+        COUNTERS[BRANCH_BLOCKED ? CTR_STALL_FETCH_BRANCH : CTR_STALL_FETCH_WAIT]++;
+        return;
+    }
+    for (uint64_t i = 0; i < (F ? F : PROC_F); ++i) {
+        proc_inst_t* inst = FETCH_PENDING;
+        FETCH_PENDING = nullptr;
+        if (inst == nullptr) {
+            inst = alloc_inst();
+            if (!next_instruction(inst)) {
+                free_inst(inst);
+                TRACE_DONE = true;
+                LAST_FETCHED = nullptr;
+                continue;
+            }
+            // The successor resolves the previous instruction's branch outcome
+            if (LAST_FETCHED != nullptr &&
+                bp_resolve(&BP, LAST_FETCHED->instruction_address, inst->instruction_address)) {
+                LAST_FETCHED->mispredicted = true;
+                BRANCH_BLOCKED = true;
+            }
+            LAST_FETCHED = inst;
+            // An I-cache miss stops fetch until the block arrives
+            uint64_t latency = mem_fetch(MEM_SHARED ? MEM_SHARED : &MEM, inst->instruction_address);
+            if (latency > MEM_CONFIG.l1i.latency) {
+                FETCH_STALL_UNTIL = CYCLE + latency - MEM_CONFIG.l1i.latency;
+            }
+            // A stalled fetch delivers this instruction once it resumes
+            if (BRANCH_BLOCKED || CYCLE < FETCH_STALL_UNTIL) {
+                FETCH_PENDING = inst;
+                break;
+            }
         }
         // Only assign tag and mark fetch cycle here.
         inst->tag = NEXT_TAG++;
@@ -99,59 +300,52 @@ void fetch() {
         inst->retired = false;
         inst->safe_to_delete = false; // Initialize safe_to_delete to false
         inst->just_retired = false;
+        inst->scheduled = false;
         inst->fetch_cycle = CYCLE;
         inst->dispatch_cycle = 0;
         inst->sched_cycle = 0;
+        inst->exec_cycle = 0;
         inst->retire_cycle = 0;
-        // Stage tracker: 5 stages: FETCH(0), DISP(1), SCHED(2), EXEC(3), RETIRE(4)
-        STAGE_TRACKER[inst->tag] = std::vector<uint64_t>(5, 0);
-        STAGE_TRACKER[inst->tag][0] = CYCLE; // FETCH
         if (DEBUG_LEVEL >= 1 && CYCLE < 10)
             std::cerr << "[CYCLE " << CYCLE << "] Fetching instruction " << inst->tag << " @ PC=0x"
                       << std::hex << inst->instruction_address << std::dec << "\n";
         FETCH_BUF.push_back(inst);
+        COUNTERS[CTR_FETCHED]++;
     }
 }
 
-void dispatch() {
+template <uint64_t F>
+void proc_t::dispatch_stage() {
     // Move up to PROC_F instructions from FETCH_BUF to DISPATCH_Q.
     uint64_t dispatched = 0;
-    while (!FETCH_BUF.empty() && dispatched < PROC_F) {
+    while (!FETCH_BUF.empty() && dispatched < (F ? F : PROC_F)) {
         proc_inst_t* inst = FETCH_BUF.front();
         FETCH_BUF.pop_front();
         // Assign dependency/tag information here, as we now have access to ROB
         for (int j = 0; j < 2; ++j) {
-            if (inst->src_reg[j] < 0 || inst->src_reg[j] >= 128) {
+            if (inst->src_reg[j] < 0 || inst->src_reg[j] >= NUM_ARCH_REGS) {
                 inst->src_ready[j] = true;
                 inst->src_tag[j] = 0;
                 continue;
             }
+            // Look up the most recent non-retired producer of this register in the RAT
+            const std::deque<proc_inst_t*>& producers = RAT[inst->src_reg[j]];
+            if (!producers.empty()) {
+                proc_inst_t* producer = producers.back();
+                inst->src_ready[j] = producer->executed;
+                inst->src_tag[j] = producer->executed ? 0 : producer->tag;
+            } else {
+                inst->src_ready[j] = true;
+                inst->src_tag[j] = 0;
+            }
             if (DEBUG_LEVEL >= 2 && CYCLE < 10) {
                 std::cerr << "[DEBUG][DISPATCH] Inst tag=" << inst->tag
                           << " src_reg[" << j << "]=" << inst->src_reg[j]
-                          << ", checking against ROB entries\n";
+                          << " -> src_tag=" << inst->src_tag[j] << "\n";
             }
-            // New logic: find the last (most recent) matching ROB entry (not retired), if any
-            uint64_t last_tag = 0;
-            bool last_ready = true;
-            for (auto rob_iter = ROB.begin(); rob_iter != ROB.end(); ++rob_iter) {
-                proc_inst_t* rob_inst = *rob_iter;
-                if (DEBUG_LEVEL >= 2 && CYCLE < 10) {
-                    // std::cerr << "  [DEBUG][DISPATCH] ROB entry tag=" << rob_inst->tag
-                    //           << ", dest_reg=" << rob_inst->dest_reg
-                    //           << ", retired=" << rob_inst->retired << "\n";
-                }
-                if (rob_inst->dest_reg == inst->src_reg[j] && !rob_inst->retired) {
-                    last_tag = rob_inst->tag;
-                    last_ready = rob_inst->executed;
-                }
-            }
-            if (last_tag != 0) {
-                inst->src_ready[j] = last_ready;
-                inst->src_tag[j] = last_ready ? 0 : last_tag;
-            } else {
-                inst->src_ready[j] = true;
-                inst->src_tag[j] = 0;
+            // Subscribe to the producer's result broadcast (once per producer)
+            if (!inst->src_ready[j] && !(j == 1 && inst->src_tag[1] == inst->src_tag[0])) {
+                producers.back()->dependents.push_back(inst);
             }
             if (!inst->src_ready[j] && (inst->src_tag[j] <= 0 || inst->src_tag[j] >= NEXT_TAG)) {
                 std::cerr << "[ERROR] src_tag[" << j << "] = " << inst->src_tag[j]
@@ -161,8 +355,12 @@ void dispatch() {
         }
         DISPATCH_Q.push_back(inst);
         ROB.push_back(inst);
+        COUNTERS[CTR_DISPATCHED]++;
+        // This instruction is now the most recent producer of its destination
+        if (inst->dest_reg >= 0 && inst->dest_reg < NUM_ARCH_REGS) {
+            RAT[inst->dest_reg].push_back(inst);
+        }
         inst->dispatch_cycle = CYCLE;
-        STAGE_TRACKER[inst->tag][1] = CYCLE; // DISPATCH
         if (DEBUG_LEVEL >= 1 && CYCLE < 10) {
             std::cerr << "[CYCLE " << CYCLE << "] Dispatched instruction " << inst->tag
                       << " @ PC=0x" << std::hex << inst->instruction_address << std::dec << "\n";
@@ -177,11 +375,13 @@ void dispatch() {
     FETCH_BUF.clear();
 }
 
-void schedule() {
-    uint64_t max_sched_q_size = 2 * (PROC_K0 + PROC_K1 + PROC_K2);
+template <uint64_t K0, uint64_t K1, uint64_t K2>
+void proc_t::schedule_stage() {
+    uint64_t max_sched_q_size = (K0 && K1 && K2) ? 2 * (K0 + K1 + K2) : 2 * (PROC_K0 + PROC_K1 + PROC_K2);
     uint64_t to_schedule = DISPATCH_Q.size();
     for (uint64_t i = 0; i < to_schedule; ++i) {
         if (SCHED_Q.size() >= max_sched_q_size) {
+            COUNTERS[CTR_STALL_SCHED_FULL]++;
             if (DEBUG_LEVEL >= 1 && CYCLE < 10) {
                 std::cerr << "[CYCLE " << CYCLE << "] SCHED_Q full, stopping schedule\n";
             }
@@ -190,8 +390,10 @@ void schedule() {
         proc_inst_t* inst = DISPATCH_Q.front();
         DISPATCH_Q.pop_front();
         inst->sched_cycle = CYCLE;
-        STAGE_TRACKER[inst->tag][2] = CYCLE;
         SCHED_Q.push_back(inst);
+        inst->scheduled = true;
+        COUNTERS[CTR_SCHEDULED]++;
+        make_ready_if_able(inst);
         if (DEBUG_LEVEL >= 1 && CYCLE < 10) {
             std::cerr << "[CYCLE " << CYCLE << "] Scheduled instruction " << inst->tag
                       << " @ PC=0x" << std::hex << inst->instruction_address << std::dec << "\n";
@@ -199,49 +401,65 @@ void schedule() {
     }
 }
 
-void execute() {
+template <uint64_t K0, uint64_t K1, uint64_t K2>
+void proc_t::execute_stage() {
+    // Multi-cycle operations whose result is produced this cycle
+    if (WHEEL_PENDING) {
+        std::vector<proc_inst_t*>& completed = WHEEL[CYCLE & WHEEL_MASK];
+        for (proc_inst_t* inst : completed) {
+            on_complete(inst);
+        }
+        WHEEL_PENDING -= completed.size();
+        completed.clear();
+    }
+
     // New FU scheduling: ordered by FU class (k0, k1, k2), FIFO within each class.
-    static std::vector<uint64_t> this_cycle_tags;
-    auto try_execute_class = [&](int fu_class, std::vector<uint64_t>& fu_vector) {
-        for (auto& inst : SCHED_Q) {
-            if (inst->issued) continue;
-            int op = inst->op_code;
-            if (op == -1) op = 1;
-            if (op != fu_class) continue;
-            if (!(inst->src_ready[0] && inst->src_ready[1] &&
-                  inst->src_tag[0] == 0 && inst->src_tag[1] == 0)) continue;
-            for (size_t i = 0; i < fu_vector.size(); ++i) {
-                if (fu_vector[i] == 0) {
-                    fu_vector[i] = 1;
-                    inst->issued = true;
-                    inst->executed = true;
-                    // Updated logic: collect tags for this cycle
-                    this_cycle_tags.push_back(inst->tag);
-                    BROADCAST_TAGS.insert(inst->tag);
-                    STAGE_TRACKER[inst->tag][3] = CYCLE;
-                    if (DEBUG_LEVEL >= 1 && CYCLE < 10)
-                        std::cerr << "[CYCLE " << CYCLE << "] Issued and executed instruction " << inst->tag
-                                  << " to FU, completed at cycle " << CYCLE << "\n";
-                    break;
-                }
+    auto try_execute_class = [&](int fu_class, std::vector<uint64_t>& fu_vector, size_t fu_count) {
+        // Issue the oldest ready instructions of this class to free FUs; a core
+        // sharing its FUs with others only uses those granted to it
+        uint64_t interval = FU_TIMING.interval[fu_class];
+        bool granted = !(K0 && K1 && K2) && SHARED_FUS;
+        size_t candidates = granted ? FU_GRANT[fu_class].size() : fu_count;
+        for (size_t j = 0; j < candidates; ++j) {
+            size_t i = granted ? FU_GRANT[fu_class][j] : j;
+            if (!fu_available(fu_class, fu_vector[i])) continue;
+            proc_inst_t* inst = SCHED_Q.pop_oldest_ready(fu_class);
+            if (inst == nullptr) break;
+            fu_vector[i] = interval ? CYCLE + interval : 1;
+            inst->issued = true;
+            COUNTERS[CTR_ISSUED_K0 + fu_class]++;
+            inst->exec_cycle = CYCLE;
+            uint64_t latency = FU_TIMING.latency[fu_class];
+            if (inst->data_address != 0) latency += mem_data(MEM_SHARED ? MEM_SHARED : &MEM, inst->data_address);
+            inst->complete_cycle = CYCLE + std::max<uint64_t>(latency, 1) - 1;
+            if (inst->complete_cycle == CYCLE) {
+                // Updated logic: collect tags for this cycle
+                on_complete(inst);
+            } else {
+                schedule_completion(inst);
             }
+            if (DEBUG_LEVEL >= 1 && CYCLE < 10)
+                std::cerr << "[CYCLE " << CYCLE << "] Issued and executed instruction " << inst->tag
+                          << " to FU, completed at cycle " << CYCLE << "\n";
         }
     };
 
     // Enforce FU class order: k0, then k1, then k2
-    try_execute_class(0, FU_K0);
-    try_execute_class(1, FU_K1);
-    try_execute_class(2, FU_K2);
+    try_execute_class(0, FU_K0, K0 ? K0 : FU_K0.size());
+    try_execute_class(1, FU_K1, K1 ? K1 : FU_K1.size());
+    try_execute_class(2, FU_K2, K2 ? K2 : FU_K2.size());
+    count_issue_waits(1);
 
     // After FU execution, append sorted tags from this cycle to RETIRE_BUFFER
-    if (!this_cycle_tags.empty()) {
-        std::sort(this_cycle_tags.begin(), this_cycle_tags.end());
-        RETIRE_BUFFER.insert(RETIRE_BUFFER.end(), this_cycle_tags.begin(), this_cycle_tags.end());
-        this_cycle_tags.clear();
+    if (!THIS_CYCLE_TAGS.empty()) {
+        std::sort(THIS_CYCLE_TAGS.begin(), THIS_CYCLE_TAGS.end());
+        RETIRE_BUFFER.insert(RETIRE_BUFFER.end(), THIS_CYCLE_TAGS.begin(), THIS_CYCLE_TAGS.end());
+        THIS_CYCLE_TAGS.clear();
     }
 }
 
-void update() {
+template <uint64_t R>
+void proc_t::update_stage() {
     // No need to complete instructions in update, as execution is immediate in execute()
     // Remove FU freeing logic here; FUs are now freed at retire time.
 
@@ -263,8 +481,9 @@ void update() {
         }
         // Print ROB contents for debug
         std::cerr << "[DEBUG] ROB Contents:\n";
-        for (size_t i = 0; i < ROB.size(); ++i) {
-            proc_inst_t* inst = ROB[i];
+        std::vector<proc_inst_t*> rob_insts = ROB.in_order();
+        for (size_t i = 0; i < rob_insts.size(); ++i) {
+            proc_inst_t* inst = rob_insts[i];
             std::cerr << "  [ROB " << i << "] "
                       << "Tag=" << inst->tag
                       << " Addr=0x" << std::hex << inst->instruction_address << std::dec
@@ -315,163 +534,223 @@ void update() {
     }
 
     // Retire in-order using RETIRE_BUFFER (new logic)
-    // Take first PROC_R tags from RETIRE_BUFFER
-    std::vector<uint64_t> retire_candidates;
-    for (size_t i = 0; i < RETIRE_BUFFER.size() && i < PROC_R; ++i) {
-        retire_candidates.push_back(RETIRE_BUFFER[i]);
-    }
-    // Sort candidates by tag value
-    std::sort(retire_candidates.begin(), retire_candidates.end());
-    int retire_count = 0;
-    for (uint64_t tag_to_retire : retire_candidates) {
-        auto rob_it = std::find_if(ROB.begin(), ROB.end(), [&](proc_inst_t* inst) {
-            return inst->tag == tag_to_retire;
-        });
-        if (rob_it == ROB.end()) continue;
-        proc_inst_t* inst = *rob_it;
-        if (!inst->executed || inst->retired) continue;
+    // Take the first PROC_R tags from RETIRE_BUFFER, in tag order. Every tag in
+    // RETIRE_BUFFER belongs to an executed, unretired instruction still in the ROB.
+    size_t retire_count = std::min<size_t>(RETIRE_BUFFER.size(), R ? R : PROC_R);
+    std::sort(RETIRE_BUFFER.begin(), RETIRE_BUFFER.begin() + retire_count);
+    for (size_t n = 0; n < retire_count; ++n) {
+        uint64_t tag_to_retire = RETIRE_BUFFER.front();
+        RETIRE_BUFFER.pop_front();
+        proc_inst_t* inst = ROB.find(tag_to_retire);
+        if (inst == nullptr || !inst->executed || inst->retired) continue;
         if (DEBUG_LEVEL >= 1 && CYCLE < 10)
             std::cerr << "[CYCLE " << CYCLE << "] Retiring instruction " << inst->tag << "\n";
         inst->retired = true;
         inst->just_retired = true;
         inst->safe_to_delete = true;
+        THIS_CYCLE_RETIRED.push_back(inst);
         inst->retire_cycle = CYCLE;
-        STAGE_TRACKER[inst->tag][4] = CYCLE;
+        record_timeline(inst);
         INSTR_RETIRE_NUM++;
-        // Free FU
+        COUNTERS[CTR_RETIRED]++;
+        LAST_RETIRE_CYCLE = CYCLE;
+        if (INSTR_RETIRE_NUM == MEASURE_AFTER) {
+            MEASURE_START_CYCLE = CYCLE;
+            MEASURE_START_DISP_NUM = DISP_QUEUE_NUM;
+            DISP_QUEUE_MAX = 0;
+        }
+        // Drop this instruction from the RAT. Retirement is close to tag order, so
+        // the entry is normally found at or near the front of the producer list.
+        if (inst->dest_reg >= 0 && inst->dest_reg < NUM_ARCH_REGS) {
+            std::deque<proc_inst_t*>& producers = RAT[inst->dest_reg];
+            auto rat_it = std::find(producers.begin(), producers.end(), inst);
+            if (rat_it != producers.end()) producers.erase(rat_it);
+        }
+        // Free FU (pipelined FUs free themselves after their initiation interval)
         int op = inst->op_code;
         if (op == -1) op = 1;
         std::vector<uint64_t>* fuvec = get_fu_vec(op);
-        for (size_t i = 0; i < fuvec->size(); ++i) {
+        for (size_t i = 0; i < fuvec->size() && FU_TIMING.interval[op] == 0; ++i) {
             if ((*fuvec)[i] > 0) {
                 (*fuvec)[i] = 0;
                 break;
             }
         }
-        // Remove this tag from RETIRE_BUFFER
-        auto it = std::find(RETIRE_BUFFER.begin(), RETIRE_BUFFER.end(), tag_to_retire);
-        if (it != RETIRE_BUFFER.end()) {
-            RETIRE_BUFFER.erase(it);
-        }
-        retire_count++;
-        if (retire_count >= PROC_R) break;
     }
 
-    // Wake up dependent instructions in SCHED_Q (NO in-cycle wakeup from retired instructions)
-    for (auto& inst : SCHED_Q) {
-        for (int j = 0; j < 2; ++j) {
-            if (!inst->src_ready[j]) {
-                if (inst->src_tag[j] == 0) continue;
-                if (BROADCAST_TAGS.count(inst->src_tag[j])) {
-                    inst->src_ready[j] = true;
-                    if (DEBUG_LEVEL >= 2 && CYCLE < 10) std::cerr << "[CYCLE " << CYCLE << "] Woke up src[" << j << "] of inst " << inst->tag
-                              << " from tag " << inst->src_tag[j] << "\n";
-                    inst->src_tag[j] = 0;
-                }
-                else {
-                    // Fallback: If tag is not found in ROB or SCHED_Q and in range, consider it implicitly ready
-                    bool valid_tag = false;
-                    for (auto& rob_inst : ROB) {
-                        if (rob_inst->tag == inst->src_tag[j]) {
-                            valid_tag = true;
-                            break;
-                        }
-                    }
-                    for (auto& sched_inst : SCHED_Q) {
-                        if (sched_inst->tag == inst->src_tag[j]) {
-                            valid_tag = true;
-                            break;
-                        }
-                    }
-                    // If the tag is not valid anymore and in range, consider it implicitly ready
-                    if (!valid_tag && inst->src_tag[j] > 0 && inst->src_tag[j] < NEXT_TAG) {
-                        inst->src_ready[j] = true;
-                        // Save for debug before clearing
-                        uint64_t old_tag = inst->src_tag[j];
-                        inst->src_tag[j] = 0;
-                        if (DEBUG_LEVEL >= 1 && CYCLE < 10)
-                            std::cerr << "[INFO] src[" << j << "] of inst " << inst->tag << " assumed ready: tag "
-                                      << old_tag << " not found in ROB or SCHED_Q\n";
-                    }
+    // Wake up consumers of the instructions retired in the previous cycle (the
+    // result broadcast is delayed by one cycle; NO in-cycle wakeup from retirement).
+    // Only the subscribed dependents are touched, not the whole SCHED_Q.
+    for (auto* producer : PREV_CYCLE_RETIRED) {
+        for (auto* consumer : producer->dependents) {
+            for (int j = 0; j < 2; ++j) {
+                if (!consumer->src_ready[j] && consumer->src_tag[j] == producer->tag) {
+                    consumer->src_ready[j] = true;
+                    consumer->src_tag[j] = 0;
+                    COUNTERS[CTR_WAKEUPS]++;
+                    if (DEBUG_LEVEL >= 1 && CYCLE < 10)
+                        std::cerr << "[WAKEUP][JUST_RETIRED_DELAYED] src[" << j << "] of inst " << consumer->tag
+                                  << " woken by delayed just-retired tag=" << producer->tag << "\n";
                 }
             }
+            make_ready_if_able(consumer);
         }
+        producer->dependents.clear();
+        producer->just_retired = false;
     }
 
-    // Wake up based on just-retired instructions (delayed by one cycle)
-    static std::unordered_set<uint64_t> PREV_CYCLE_RETIRED_TAGS;
-    std::unordered_set<uint64_t> JUST_RETIRED_TAGS = PREV_CYCLE_RETIRED_TAGS;
+    // Instructions retired this cycle broadcast to their dependents next cycle
+    PREV_CYCLE_RETIRED.swap(THIS_CYCLE_RETIRED);
+    THIS_CYCLE_RETIRED.clear();
+}
 
-    // Wake up based on tags in JUST_RETIRED_TAGS (delayed effect - tags retired in previous cycle)
-    for (auto& inst : SCHED_Q) {
-        for (int j = 0; j < 2; ++j) {
-            if (!inst->src_ready[j] && inst->src_tag[j] != 0 && JUST_RETIRED_TAGS.count(inst->src_tag[j])) {
-                inst->src_ready[j] = true;
-                // Save for debug before clearing
-                uint64_t old_tag = inst->src_tag[j];
-                inst->src_tag[j] = 0;
-                if (DEBUG_LEVEL >= 1 && CYCLE < 10)
-                    std::cerr << "[WAKEUP][JUST_RETIRED_DELAYED] src[" << j << "] of inst " << inst->tag
-                              << " woken by delayed just-retired tag=" << old_tag << "\n";
-            }
-        }
-    }
 
-    // After retirement loop, update PREV_CYCLE_RETIRED_TAGS with tags of just-retired instructions (for next cycle)
-    PREV_CYCLE_RETIRED_TAGS.clear();
-    for (auto& inst : SCHED_Q) {
-        if (inst->just_retired) {
-            PREV_CYCLE_RETIRED_TAGS.insert(inst->tag);
+// Pipeline stages with the instance's runtime widths
+void proc_t::fetch() { fetch_stage<0>(); }
+void proc_t::dispatch() { dispatch_stage<0>(); }
+void proc_t::schedule() { schedule_stage<0, 0, 0>(); }
+void proc_t::execute() { execute_stage<0, 0, 0>(); }
+void proc_t::update() { update_stage<0>(); }
+
+// Helper: count `cycles` cycles of scheduled instructions waiting at issue, for an
+// operand or, ready, for an FU
+void proc_t::count_issue_waits(uint64_t cycles) {
+    uint64_t ready = 0;
+    for (int c = 0; c < 3; ++c) ready += SCHED_Q.ready_count(c);
+    COUNTERS[CTR_WAIT_FU] += cycles * ready;
+    COUNTERS[CTR_WAIT_OPERANDS] += cycles * (SCHED_Q.unissued - ready);
+}
+
+// Helper: count the cycles CYCLE .. CYCLE + cycles - 1, over which the queues
+// stay as they are: their occupancy and the busy FUs (a pipelined FU is busy
+// until the cycle its status names)
+void proc_t::count_cycle_state(uint64_t cycles) {
+    COUNTERS[CTR_CYCLES] += cycles;
+    COUNTERS[CTR_DISPATCH_Q_OCCUPANCY] += cycles * DISPATCH_Q.size();
+    COUNTERS[CTR_SCHED_Q_OCCUPANCY] += cycles * SCHED_Q.size();
+    COUNTERS[CTR_ROB_OCCUPANCY] += cycles * ROB.size();
+    const std::vector<uint64_t>* pools[3] = { &FU_K0, &FU_K1, &FU_K2 };
+    for (int c = 0; c < 3; ++c) {
+        uint64_t busy = 0;
+        for (uint64_t fu : *pools[c]) {
+            if (FU_TIMING.interval[c] == 0) busy += fu ? cycles : 0;
+            else if (fu > CYCLE) busy += std::min(fu - CYCLE, cycles);
         }
+        COUNTERS[CTR_FU_BUSY_K0 + c] += busy;
     }
+}
 
-    // After retiring from ROB, check all instructions (ROB and SCHED_Q) for safe deletion
-    // An instruction is safe to delete if retired and no other instruction references its tag in src_tag[0/1]
-    auto safe_to_delete_check = [&](proc_inst_t* inst) {
-        if (!inst->retired || inst->safe_to_delete) return false;
-        uint64_t tag = inst->tag;
-        // Check if any instruction in ROB or SCHED_Q references this tag
-        for (auto& other_inst : ROB) {
-            if (other_inst->src_tag[0] == tag || other_inst->src_tag[1] == tag) return false;
+// Helper: true if running the current cycle could not change any state: fetch is
+// stalled or done, nothing is left to dispatch, nothing can retire, wake up, issue, enter SCHED_Q or
+// leave it. Such a cycle only adds to the dispatch queue occupancy sum.
+bool proc_t::pipeline_idle() const {
+    bool fetch_idle = BRANCH_BLOCKED || CYCLE < FETCH_STALL_UNTIL || (TRACE_DONE && FETCH_PENDING == nullptr);
+    if (!fetch_idle || !FETCH_BUF.empty()) return false;
+    if (!RETIRE_BUFFER.empty() || !PREV_CYCLE_RETIRED.empty()) return false;
+    if (!SCHED_Q_DELETE_BUFFER[0].empty()) return false;
+    if (!DISPATCH_Q.empty() && SCHED_Q.size() < 2 * (PROC_K0 + PROC_K1 + PROC_K2)) return false;
+    const std::vector<uint64_t>* pools[3] = { &FU_K0, &FU_K1, &FU_K2 };
+    for (int c = 0; c < 3; ++c) {
+        if (!SCHED_Q.any_ready(c)) continue;
+        for (uint64_t fu : *pools[c]) {
+            if (fu_available(c, fu)) return false;
         }
-        for (auto& other_inst : SCHED_Q) {
-            if (other_inst->src_tag[0] == tag || other_inst->src_tag[1] == tag) return false;
-        }
-        return true;
-    };
-
+    }
+    return true;
+}
 
-    // Check SCHED_Q instructions for safe deletion
-    for (auto it = SCHED_Q.begin(); it != SCHED_Q.end(); ) {
-        proc_inst_t* inst = *it;
-        if (safe_to_delete_check(inst)) {
-            inst->safe_to_delete = true;
-            // Do not delete or erase here; deletion deferred to run_proc()
-            ++it;
-        } else {
-            ++it;
+// Helper: earliest future cycle at which a pending event (rather than a stage acting
+// on the current state) can change the pipeline, or UINT64_MAX if none is pending:
+// a completion on the timing wheel, the end of an I-cache stall, or a pipelined FU
+// freeing up for a waiting instruction. A fetch blocked on a mispredicted branch
+// resumes only through that branch's completion.
+uint64_t proc_t::next_event_cycle() const {
+    uint64_t next = (FETCH_STALL_UNTIL > CYCLE && !BRANCH_BLOCKED) ? FETCH_STALL_UNTIL : UINT64_MAX;
+    if (WHEEL_PENDING) {
+        for (uint64_t d = 0; d <= WHEEL_MASK; ++d) {
+            if (!WHEEL[(CYCLE + d) & WHEEL_MASK].empty()) {
+                next = std::min(next, CYCLE + d);
+                break;
+            }
         }
     }
-
-    // At the end of update, reset just_retired flags
-    for (auto& inst : SCHED_Q) {
-        inst->just_retired = false;
+    const std::vector<uint64_t>* pools[3] = { &FU_K0, &FU_K1, &FU_K2 };
+    for (int c = 0; c < 3; ++c) {
+        if (FU_TIMING.interval[c] == 0 || !SCHED_Q.any_ready(c)) continue;
+        for (uint64_t fu : *pools[c]) next = std::min(next, fu);
     }
+    return next;
 }
 
+// Helper: advance CYCLE to the next event while the pipeline is idle, accounting
+// for the skipped cycles as if they had been simulated. Never skips past a
+// checkpoint cycle or the end of a counter log interval.
+void proc_t::skip_idle_cycles() {
+    if (!SKIP_IDLE || !pipeline_idle()) return;
+    uint64_t target = next_event_cycle();
+    if (target == UINT64_MAX) return;
+    if (CHECKPOINT_AT > CYCLE) target = std::min(target, CHECKPOINT_AT);
+    if (CHECKPOINT_EVERY) target = std::min(target, (CYCLE + CHECKPOINT_EVERY - 1) / CHECKPOINT_EVERY * CHECKPOINT_EVERY);
+    if (COUNTER_LOG.every) target = std::min(target, (CYCLE + COUNTER_LOG.every - 1) / COUNTER_LOG.every * COUNTER_LOG.every);
+    if (target <= CYCLE) return;
+    uint64_t skipped = target - CYCLE;
+    if (DISPATCH_READY) DISP_QUEUE_NUM += skipped * DISPATCH_Q.size();
+    PROFILE_OCCUPANCY(PROFILE, PROF_DISPATCH_Q, DISPATCH_Q.size(), skipped);
+    PROFILE_OCCUPANCY(PROFILE, PROF_SCHED_Q, SCHED_Q.size(), skipped);
+    PROFILE_OCCUPANCY(PROFILE, PROF_ROB, ROB.size(), skipped);
+    // Every skipped cycle repeats the stalls and waits of an idle cycle
+    if (BRANCH_BLOCKED) COUNTERS[CTR_STALL_FETCH_BRANCH] += skipped;
+    else if (CYCLE < FETCH_STALL_UNTIL) COUNTERS[CTR_STALL_FETCH_WAIT] += skipped;
+    if (!DISPATCH_Q.empty()) COUNTERS[CTR_STALL_SCHED_FULL] += skipped;
+    count_issue_waits(skipped);
+    count_cycle_state(skipped);
+    IDLE_CYCLES_SKIPPED += skipped;
+    CYCLE = target;
+}
 
-void run_proc(proc_stats_t* p_stats)
+bool proc_t::end_cycle()
 {
-    if (CYCLE < 10 && DEBUG_LEVEL >= 1) std::cerr << "[DEBUG] NEXT_TAG = " << NEXT_TAG << "\n";
+    count_cycle_state(1);
+
+    // Check for simulation end: all queues empty, ROB empty
+    bool done = DISPATCH_Q.empty() && SCHED_Q.empty() && ROB.empty() && FETCH_BUF.empty() &&
+                FETCH_PENDING == nullptr;
+    if (done) return true;
+
+    // Mark instructions for delayed deletion from SCHED_Q (once, in the cycle they
+    // retired, so no stale handle is left behind once their slot is recycled).
+    // update() has just moved this cycle's retirements to PREV_CYCLE_RETIRED.
+    for (auto* inst : PREV_CYCLE_RETIRED) {
+        SCHED_Q_DELETE_BUFFER[1].push_back(inst);
+    }
+
+    // Perform actual deletion from SCHED_Q for instructions marked in previous cycle
+    for (auto* inst : SCHED_Q_DELETE_BUFFER[0]) {
+        size_t sched_pos = SCHED_Q.find(inst->tag);
+        if (sched_pos != SCHED_Q.size()) {
+            SCHED_Q.erase(sched_pos);
+            // 在 SCHED_Q 删除后再从 ROB 删除
+            if (ROB.find(inst->tag) == inst) {
+                free_inst(inst);
+                ROB.erase(inst->tag);
+            }
+        }
+    }
+    SCHED_Q_DELETE_BUFFER[0].clear();
+    std::swap(SCHED_Q_DELETE_BUFFER[0], SCHED_Q_DELETE_BUFFER[1]);
 
-    // Main simulation loop
-    // Static buffers to hold instructions to be deleted from SCHED_Q, double-buffered
-    static std::deque<proc_inst_t*> SCHED_Q_DELETE_BUFFER[2];
+    // Advance cycle
+    CYCLE++;
+    return false;
+}
 
+// Helper: the main simulation loop, for F, R and FU counts fixed at compile time
+// (0 = the instance's runtime value)
+template <uint64_t F, uint64_t R, uint64_t K0, uint64_t K1, uint64_t K2>
+void proc_t::run_loop()
+{
     while (true) {
-        RESULT_TAGS = BROADCAST_TAGS;
-        BROADCAST_TAGS.clear();
-
+        PROFILE_START(PROFILE, ticks);
         // if (DEBUG_LEVEL >= 2 && CYCLE >= 10) break;
         if (DEBUG_LEVEL >= 1 && CYCLE < 10) std::cerr << "[CYCLE " << CYCLE << "] Entering loop: ROB=" << ROB.size()
             << ", DISPATCH_Q=" << DISPATCH_Q.size()
@@ -479,54 +758,54 @@ void run_proc(proc_stats_t* p_stats)
             << "\n";
 
         // Update (retire, wakeup, FU reclaim, broadcast results)
-        update();
+        update_stage<R>();
+        PROFILE_LAP(PROFILE, PROF_UPDATE, ticks);
 
         // Execute
-        execute();
+        execute_stage<K0, K1, K2>();
+        PROFILE_LAP(PROFILE, PROF_EXECUTE, ticks);
         // Schedule
-        schedule();
+        schedule_stage<K0, K1, K2>();
+        PROFILE_LAP(PROFILE, PROF_SCHEDULE, ticks);
 
         // Dispatch (only if DISPATCH_READY from previous cycle)
         if (DISPATCH_READY) {
-            dispatch();
+            dispatch_stage<F>();
         }
+        PROFILE_LAP(PROFILE, PROF_DISPATCH, ticks);
 
         // Fetch, then set DISPATCH_READY for next cycle
-        fetch();
+        fetch_stage<F>();
         DISPATCH_READY = true;
-
-        // Check for simulation end: all queues empty, ROB empty
-        bool done = DISPATCH_Q.empty() && SCHED_Q.empty() && ROB.empty() && FETCH_BUF.empty();
-        if (done) break;
-
-        // Mark instructions for delayed deletion from SCHED_Q
-        for (auto& inst : SCHED_Q) {
-            if (inst->executed && inst->retired && inst->safe_to_delete) {
-                SCHED_Q_DELETE_BUFFER[1].push_back(inst);
-            }
+        PROFILE_LAP(PROFILE, PROF_FETCH, ticks);
+        PROFILE_OCCUPANCY(PROFILE, PROF_DISPATCH_Q, DISPATCH_Q.size(), 1);
+        PROFILE_OCCUPANCY(PROFILE, PROF_SCHED_Q, SCHED_Q.size(), 1);
+        PROFILE_OCCUPANCY(PROFILE, PROF_ROB, ROB.size(), 1);
+        // Stop once the pipeline has drained
+        if (end_cycle()) break;
+
+        // Jump over cycles in which no stage can change any state
+        skip_idle_cycles();
+
+        // Counter log row for the interval that has just ended
+        if (COUNTER_LOG.every && CYCLE % COUNTER_LOG.every == 0) {
+            counter_log_row(&COUNTER_LOG, COUNTERS, CYCLE);
         }
 
-        // Perform actual deletion from SCHED_Q for instructions marked in previous cycle
-        for (auto* inst : SCHED_Q_DELETE_BUFFER[0]) {
-            auto sched_it = std::find(SCHED_Q.begin(), SCHED_Q.end(), inst);
-            if (sched_it != SCHED_Q.end()) {
-                SCHED_Q.erase(sched_it);
-                // 在 SCHED_Q 删除后再从 ROB 删除
-                auto rob_it = std::find(ROB.begin(), ROB.end(), inst);
-                if (rob_it != ROB.end()) {
-                    delete *rob_it;
-                    ROB.erase(rob_it);
-                }
+        // Checkpoint between cycles; stop here if this is the requested cycle
+        if (!CHECKPOINT_PATH.empty() &&
+            ((CHECKPOINT_EVERY && CYCLE % CHECKPOINT_EVERY == 0) || CYCLE == CHECKPOINT_AT)) {
+            if (!save_checkpoint(CHECKPOINT_PATH.c_str())) {
+                std::cerr << "[ERROR] Failed to write checkpoint " << CHECKPOINT_PATH << "\n";
+            }
+            if (CYCLE == CHECKPOINT_AT) {
+                STOPPED = true;
+                break;
             }
         }
-        SCHED_Q_DELETE_BUFFER[0].clear();
-        std::swap(SCHED_Q_DELETE_BUFFER[0], SCHED_Q_DELETE_BUFFER[1]);
-
-        // Advance cycle
-        CYCLE++;
 
         // Print lightweight progress info every 1000 cycles, even when DEBUG_LEVEL == 0
-        if (CYCLE % 1000 == 0) {
+        if (PROGRESS && CYCLE % 1000 == 0) {
             std::cerr << "[INFO] Cycle " << CYCLE << ": ROB=" << ROB.size()
                       << ", DISP_Q=" << DISPATCH_Q.size()
                       << ", SCHED_Q=" << SCHED_Q.size()
@@ -536,55 +815,65 @@ void run_proc(proc_stats_t* p_stats)
         if (CYCLE < 10 && DEBUG_LEVEL >= 1) std::cerr << "[CYCLE " << CYCLE << "] ROB=" << ROB.size()
                   << " DISP_Q=" << DISPATCH_Q.size()
                   << " SCHED_Q=" << SCHED_Q.size()
-                  << " RESULT_TAGS=" << RESULT_TAGS.size()
                   << " RETIRED=" << INSTR_RETIRE_NUM << std::endl;
+        PROFILE_LAP(PROFILE, PROF_OTHER, ticks);
+    }
+}
+
+void proc_t::run(proc_stats_t* p_stats)
+{
+    if (CYCLE < 10 && DEBUG_LEVEL >= 1) std::cerr << "[DEBUG] NEXT_TAG = " << NEXT_TAG << "\n";
+
+    // Main simulation loop. Common configurations run a copy specialized for their
+    // widths and FU counts; any other runs the generic one.
+    PROFILE_RUN_BEGIN(PROFILE, CYCLE, INSTR_RETIRE_NUM);
+    if (PROC_F == 4 && PROC_R == 8 && PROC_K0 == 1 && PROC_K1 == 2 && PROC_K2 == 3) {
+        run_loop<4, 8, 1, 2, 3>();
+    } else if (PROC_F == 4 && PROC_R == 2 && PROC_K0 == 3 && PROC_K1 == 2 && PROC_K2 == 1) {
+        run_loop<4, 2, 3, 2, 1>();
+    } else {
+        run_loop<0, 0, 0, 0, 0>();
     }
+    PROFILE_RUN_END(PROFILE, CYCLE, INSTR_RETIRE_NUM);
+    // The last, partial interval ends with the final cycle
+    if (!STOPPED && COUNTER_LOG.every) counter_log_row(&COUNTER_LOG, COUNTERS, CYCLE + 1);
     // Set stats
     p_stats->cycle_count = CYCLE;
     p_stats->retired_instruction = INSTR_RETIRE_NUM;
 }
 
-// Finalizes statistics after simulation ends and writes results to output file.
-void complete_proc(proc_stats_t *p_stats) 
+// Fills in the derived statistics after a run.
+void proc_t::finish_stats(proc_stats_t* p_stats)
 {
     p_stats->max_disp_size = DISP_QUEUE_MAX;
     p_stats->avg_disp_size = static_cast<double>(DISP_QUEUE_NUM) / (p_stats->cycle_count-1);
     p_stats->avg_inst_fired = static_cast<double>(INSTR_RETIRE_NUM) / (p_stats->cycle_count-1);
     p_stats->avg_inst_retired = static_cast<double>(p_stats->retired_instruction) / (p_stats->cycle_count-1);
+}
 
-    std::ofstream file("result_test.output", std::ios::out | std::ios::trunc);
+// Finalizes statistics after simulation ends and writes results to output file.
+void proc_t::complete(proc_stats_t *p_stats)
+{
+    finish_stats(p_stats);
+    if (!OUTPUT_FILE.is_open()) return;
+
+    if (OUTPUT_BINARY) {
+        timeline_stats_t stats;
+        stats.instructions = p_stats->retired_instruction;
+        stats.max_disp_size = p_stats->max_disp_size;
+        stats.cycles = p_stats->cycle_count-1;
+        stats.avg_disp_size = p_stats->avg_disp_size;
+        stats.avg_inst_fired = p_stats->avg_inst_fired;
+        stats.avg_inst_retired = p_stats->avg_inst_retired;
+        timeline_finish(&TIMELINE_WRITER, OUTPUT_FILE, stats);
+        OUTPUT_FILE.close();
+        return;
+    }
 
-    auto out_setting = [&](const char* name, uint64_t val) { file << name << ": " << val << "\n"; };
+    // Settings and timeline rows were already streamed out during the run
+    std::ofstream& file = OUTPUT_FILE;
     auto out_stat = [&](const char* label, uint64_t val) { file << label << val << "\n"; };
 
-    file << "Processor Settings\n";
-    out_setting("R", PROC_R);
-    out_setting("k0", PROC_K0);
-    out_setting("k1", PROC_K1);
-    out_setting("k2", PROC_K2);
-    out_setting("F", PROC_F);
-    file << "\n";
-
-    file << "INST\tFETCH\tDISP\tSCHED\tEXEC\tSTATE\n";
-    // Convert map to vector for sorting
-    std::vector<std::pair<uint64_t, std::vector<uint64_t>>> ordered_tracker(STAGE_TRACKER.begin(), STAGE_TRACKER.end());
-    // Sort in ascending order by tag (C++11 compatible)
-    auto cmp_asc = [](const std::pair<uint64_t, std::vector<uint64_t>>& a,
-                      const std::pair<uint64_t, std::vector<uint64_t>>& b) {
-        return a.first < b.first;
-    };
-    std::sort(ordered_tracker.begin(), ordered_tracker.end(), cmp_asc);
-
-    for (const auto& entry : ordered_tracker) {
-        const auto& tag = entry.first;
-        const auto& stages = entry.second;
-        file << tag;
-        for (int j = 0; j < 5; ++j) {
-            file << "\t" << (stages[j] + 1);
-        }
-        file << "\n";
-    }
-
     file << "\nProcessor stats:\n";
     out_stat("Total instructions: ", p_stats->retired_instruction);
     file << std::fixed << std::setprecision(6);
@@ -597,3 +886,18 @@ void complete_proc(proc_stats_t *p_stats)
 
     file.close();
 }
+
+void setup_proc(uint64_t r, uint64_t k0, uint64_t k1, uint64_t k2, uint64_t f)
+{
+    PROC.setup(r, k0, k1, k2, f);
+}
+
+void run_proc(proc_stats_t* p_stats)
+{
+    PROC.run(p_stats);
+}
+
+void complete_proc(proc_stats_t *p_stats)
+{
+    PROC.complete(p_stats);
+}
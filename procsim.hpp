@@ -4,6 +4,15 @@
 
 #include <cstdint>
 #include <cstdio>
+#include <vector>
+#include "branch.hpp"
+#include "cache.hpp"
+#include "counters.hpp"
+#include "profile.hpp"
+#include "rob.hpp"
+#include "sched_queue.hpp"
+#include "timeline.hpp"
+#include "trace.hpp"
 
 #define DEFAULT_K0 1
 #define DEFAULT_K1 2
@@ -11,6 +20,9 @@
 #define DEFAULT_R 8
 #define DEFAULT_F 4
 
+// Number of architectural registers (valid register ids are 0..127)
+#define NUM_ARCH_REGS 128
+
 // Tomasulo pipeline instruction structure
 typedef struct _proc_inst_t
 {
@@ -18,6 +30,7 @@ typedef struct _proc_inst_t
     int32_t op_code;
     int32_t src_reg[2];
     int32_t dest_reg;
+    uint32_t data_address;    // Memory operand address, 0 if none
 
     // Tomasulo fields
     uint64_t tag;             // Unique tag for instruction
@@ -30,73 +43,258 @@ typedef struct _proc_inst_t
     uint64_t fetch_cycle;
     uint64_t dispatch_cycle;
     uint64_t sched_cycle;
+    uint64_t exec_cycle;
+    uint64_t complete_cycle;  // Cycle in which the result is produced
     uint64_t retire_cycle;
     bool safe_to_delete;      // New flag to mark when instruction is safe to delete
+    bool scheduled;           // Has entered the scheduling queue
+    bool mispredicted;        // Branch the front end mispredicted; fetch waits for its result
+    uint32_t slot;            // Index of this instruction in INST_POOL
+    std::vector<struct _proc_inst_t*> dependents; // Consumers waiting on this instruction's result
 } proc_inst_t;
-// --- Tomasulo Global Structures and Variables ---
+// --- Tomasulo Structures ---
 #include <queue>
 #include <deque>
 #include <vector>
-#include <unordered_map>
-#include <unordered_set>
+#include <string>
+#include <fstream>
 #include <iostream> // Added for debug output
 
-// Processor configuration
-extern uint64_t PROC_R; // ROB size
-extern uint64_t PROC_K0, PROC_K1, PROC_K2; // FU counts
-extern uint64_t PROC_F; // Fetch width
+// Stage timestamps of a retired instruction: FETCH(0), DISP(1), SCHED(2), EXEC(3), RETIRE(4)
+typedef struct _stage_record_t
+{
+    uint64_t stage[5];
+    bool retired;
+} stage_record_t;
 
-// Cycle counter
-extern uint64_t CYCLE;
+// Timing of the three FU classes. An operation issued in cycle c produces its
+// result at the end of cycle c + latency - 1. With interval 0 an FU is held from
+// issue until its instruction retires; with interval n > 0 it is pipelined and
+// accepts a new operation every n cycles.
+typedef struct _fu_timing_t
+{
+    uint64_t latency[3];
+    uint64_t interval[3];
+} fu_timing_t;
 
-// Instruction tag counter
-extern uint64_t NEXT_TAG;
+// Single-cycle FUs held until retire
+extern const fu_timing_t DEFAULT_FU_TIMING;
 
+typedef struct _proc_stats_t
+{
+    float avg_inst_retired;
+    float avg_inst_fired;
+    float avg_disp_size;
+    unsigned long max_disp_size;
+    unsigned long retired_instruction;
+    unsigned long cycle_count;
+} proc_stats_t;
 
-// ROB: Reorder Buffer (circular buffer)
-extern std::deque<proc_inst_t*> ROB;
+// One simulated processor. All pipeline state lives in the instance, so several
+// configurations can be simulated concurrently (see sweep.hpp).
+struct proc_t
+{
+    // Processor configuration
+    uint64_t PROC_R; // ROB size
+    uint64_t PROC_K0, PROC_K1, PROC_K2; // FU counts
+    uint64_t PROC_F; // Fetch width
 
-// Dispatch queue (FIFO)
-extern std::deque<proc_inst_t*> DISPATCH_Q;
+    // Cycle counter
+    uint64_t CYCLE;
 
-// Scheduling queue (Reservation Stations)
-extern std::deque<proc_inst_t*> SCHED_Q;
+    // Instruction tag counter
+    uint64_t NEXT_TAG;
 
-// FETCH buffer for fetched but not yet dispatched instructions
-extern std::deque<proc_inst_t*> FETCH_BUF;
+    // Persistent dispatch ready flag for one-cycle delay between fetch and dispatch
+    bool DISPATCH_READY;
 
-// Result tags (instructions that have completed execution this cycle)
-extern std::unordered_set<uint64_t> RESULT_TAGS;
+    // ROB: Reorder Buffer (circular buffer indexed by tag)
+    rob_t ROB;
 
-// Stage tracker: for output
-extern std::unordered_map<uint64_t, std::vector<uint64_t>> STAGE_TRACKER; // tag -> [fetch, disp, sched, exec, retire]
+    // Dispatch queue (FIFO)
+    std::deque<proc_inst_t*> DISPATCH_Q;
 
-// Functional Unit status
-extern std::vector<uint64_t> FU_K0; // busy_until times
-extern std::vector<uint64_t> FU_K1;
-extern std::vector<uint64_t> FU_K2;
+    // Scheduling queue (Reservation Stations), with the per-FU-class ready masks
+    sched_queue_t SCHED_Q;
 
-// Max/avg dispatch queue size tracking
-extern uint64_t DISP_QUEUE_MAX;
-extern uint64_t DISP_QUEUE_NUM;
-extern uint64_t INSTR_RETIRE_NUM;
+    // FETCH buffer for fetched but not yet dispatched instructions
+    std::deque<proc_inst_t*> FETCH_BUF;
 
-// Function prototypes for pipeline stages
-void fetch();
-void dispatch();
-void schedule();
-void execute();
-void update();
+    // Executed instructions in retirement order
+    std::deque<uint64_t> RETIRE_BUFFER;
 
-typedef struct _proc_stats_t
-{
-    float avg_inst_retired;
-    float avg_inst_fired;
-    float avg_disp_size;
-    unsigned long max_disp_size;
-    unsigned long retired_instruction;
-    unsigned long cycle_count;
-} proc_stats_t;
+    // Timeline reorder window for output: record of tag t lives at TIMELINE[t - TIMELINE_BASE_TAG].
+    // Rows are written as soon as all older tags have retired, so only the span of
+    // out-of-order retirement is held in memory.
+    std::deque<stage_record_t> TIMELINE;
+    uint64_t TIMELINE_BASE_TAG;
+
+    // Output file; the timeline is streamed into it while the simulation runs.
+    // An empty OUTPUT_PATH disables the file (used by sweeps). With OUTPUT_BINARY
+    // it is written in the binary timeline format (see timeline.hpp).
+    std::string OUTPUT_PATH;
+    std::ofstream OUTPUT_FILE;
+    bool OUTPUT_BINARY;
+    timeline_writer_t TIMELINE_WRITER;
+
+    // Instruction pool: storage for every in-flight proc_inst_t, addressed by slot
+    // index. Retired slots go on the free list and are reused by fetch(), so once the
+    // pool has grown to the peak in-flight count no further allocation happens.
+    std::deque<proc_inst_t> INST_POOL;
+    std::vector<uint32_t> INST_FREE_SLOTS;
+
+    // Register alias table: for each architectural register, the dispatched but not
+    // yet retired instructions that write it, in tag order (back() = most recent)
+    std::vector<std::deque<proc_inst_t*>> RAT;
+
+    // FU latencies and initiation intervals; kept across setup()
+    fu_timing_t FU_TIMING;
+
+    // Timing wheel of multi-cycle operations: slot c & WHEEL_MASK holds those that
+    // complete in cycle c. It has more slots than the longest latency, so slots never alias.
+    std::vector<std::vector<proc_inst_t*>> WHEEL;
+    uint64_t WHEEL_MASK;
+    uint64_t WHEEL_PENDING;
+
+    // Cache hierarchy configuration (kept across setup()) and state. Fetch stops on
+    // an I-cache miss until FETCH_STALL_UNTIL; the instruction that missed waits in
+    // FETCH_PENDING, untagged. Instructions with a data address add the latency of
+    // their D-cache access to that of their FU.
+    mem_config_t MEM_CONFIG;
+    mem_hier_t MEM;
+    uint64_t FETCH_STALL_UNTIL;
+    proc_inst_t* FETCH_PENDING;
+
+    // Branch predictor configuration (kept across setup()) and state. A branch's
+    // outcome is known once the instruction after it, its successor in the trace,
+    // has been read; LAST_FETCHED is the instruction still waiting for that. After a
+    // mispredicted branch, fetch stays off until the branch has executed, and then
+    // for the redirect penalty.
+    bp_config_t BP_CONFIG;
+    branch_pred_t BP;
+    bool BRANCH_BLOCKED;
+    proc_inst_t* LAST_FETCHED;
+
+    // Functional Unit status: 1 while held until retire, or for pipelined
+    // classes the cycle from which the FU accepts a new operation
+    std::vector<uint64_t> FU_K0;
+    std::vector<uint64_t> FU_K1;
+    std::vector<uint64_t> FU_K2;
+
+    // Multicore runs (see multicore.hpp). With SHARED_FUS the FU pools belong to
+    // all cores: FU_K0..2 mark the shared FUs this core occupies, and execute()
+    // issues only to the FUs granted to it for the cycle in FU_GRANT. MEM_SHARED,
+    // if set, is a cache hierarchy common to all cores that replaces MEM.
+    bool SHARED_FUS;
+    std::vector<uint32_t> FU_GRANT[3];
+    mem_hier_t* MEM_SHARED;
+
+    // Max/avg dispatch queue size tracking
+    uint64_t DISP_QUEUE_MAX;
+    uint64_t DISP_QUEUE_NUM;
+    uint64_t INSTR_RETIRE_NUM;
+
+    // Per-cycle scratch state carried between stages and cycles
+    std::vector<uint64_t> THIS_CYCLE_TAGS;          // Tags executed this cycle
+    std::vector<proc_inst_t*> PREV_CYCLE_RETIRED;   // Retired last cycle, wake dependents now
+    std::vector<proc_inst_t*> THIS_CYCLE_RETIRED;
+    std::deque<proc_inst_t*> SCHED_Q_DELETE_BUFFER[2]; // Double-buffered delayed deletion
+
+    // Instruction source: a shared decoded trace if set, else read_instruction()
+    const trace_inst_t* TRACE;
+    size_t TRACE_LEN;
+    size_t TRACE_POS;
+    bool TRACE_DONE;          // fetch() has run out of instructions
+
+    // Idle-cycle skipping (on by default; results are identical either way)
+    bool SKIP_IDLE;
+    uint64_t IDLE_CYCLES_SKIPPED;
+
+    // Print a progress line to stderr every 1000 cycles
+    bool PROGRESS;
+
+    // Event counters (see counters.hpp) and their interval log; the log's
+    // interval and file are kept across setup()
+    uint64_t COUNTERS[NUM_COUNTERS];
+    counter_log_t COUNTER_LOG;
+
+    // Host-side profile of run() (see profile.hpp); PROFILE.enabled is kept across setup()
+    proc_profile_t PROFILE;
+
+    // Interval measurement for sampled and partitioned simulation: the cycle at
+    // which the MEASURE_AFTER-th instruction retired and DISP_QUEUE_NUM then, and
+    // the cycle of the last retirement. From that point on DISP_QUEUE_MAX only
+    // covers the measured cycles.
+    uint64_t MEASURE_AFTER;
+    uint64_t MEASURE_START_CYCLE;
+    uint64_t MEASURE_START_DISP_NUM;
+    uint64_t LAST_RETIRE_CYCLE;
+
+    // Checkpointing (see checkpoint.cpp): save to CHECKPOINT_PATH every
+    // CHECKPOINT_EVERY cycles, and/or once at CHECKPOINT_AT and then stop
+    std::string CHECKPOINT_PATH;
+    uint64_t CHECKPOINT_EVERY;
+    uint64_t CHECKPOINT_AT;
+    bool STOPPED;             // run() returned at CHECKPOINT_AT rather than at the end
+
+    proc_t();
+
+    // Take the model settings (FU timing, caches, branch predictor, idle skipping) of other
+    void copy_model(const proc_t& other);
+
+    void setup(uint64_t r, uint64_t k0, uint64_t k1, uint64_t k2, uint64_t f);
+    void run(proc_stats_t* p_stats);
+    void finish_stats(proc_stats_t* p_stats);
+    void complete(proc_stats_t* p_stats);
+
+    // Checkpoint the state between two cycles; restore it into a fresh
+    // instance (the instruction source must be attached first)
+    bool save_checkpoint(const char* path);
+    bool restore_checkpoint(const char* path);
+    // Change R/k/F of a restored state; false if a pool shrinks below its busy FUs
+    bool reconfigure(uint64_t r, uint64_t k0, uint64_t k1, uint64_t k2, uint64_t f);
+
+    // Pipeline stages
+    void fetch();
+    void dispatch();
+    void schedule();
+    void execute();
+    void update();
+    // Close the current cycle after its stages have run: true if the pipeline has
+    // drained, otherwise drops retired entries from SCHED_Q and the ROB and advances CYCLE
+    bool end_cycle();
+
+private:
+    bool next_instruction(proc_inst_t* p_inst);
+    proc_inst_t* alloc_inst();
+    void free_inst(proc_inst_t* inst);
+    std::vector<uint64_t>* get_fu_vec(int32_t op);
+    bool fu_available(int cls, uint64_t fu) const;
+    void schedule_completion(proc_inst_t* inst);
+    void on_complete(proc_inst_t* inst);
+    void make_ready_if_able(proc_inst_t* inst);
+    void record_timeline(const proc_inst_t* inst);
+    void open_output(uint64_t resume_offset);
+    // Stages and main loop with widths and FU counts fixed at compile time; a 0
+    // takes the runtime value (PROC_F, PROC_R, PROC_K0..2) instead
+    template <uint64_t F> void fetch_stage();
+    template <uint64_t F> void dispatch_stage();
+    template <uint64_t K0, uint64_t K1, uint64_t K2> void schedule_stage();
+    template <uint64_t K0, uint64_t K1, uint64_t K2> void execute_stage();
+    template <uint64_t R> void update_stage();
+    template <uint64_t F, uint64_t R, uint64_t K0, uint64_t K1, uint64_t K2> void run_loop();
+    void count_issue_waits(uint64_t cycles);
+    void count_cycle_state(uint64_t cycles);
+    bool pipeline_idle() const;
+    uint64_t next_event_cycle() const;
+    void skip_idle_cycles();
+
+    proc_t(const proc_t&);
+    proc_t& operator=(const proc_t&);
+};
+
+// Processor instance used by the single-run interface below
+extern proc_t PROC;
 
 bool read_instruction(proc_inst_t* p_inst);
 
@@ -106,5 +304,3 @@ void run_proc(proc_stats_t* p_stats);
 void complete_proc(proc_stats_t *p_stats);
 
 #endif /* PROCSIM_HPP */
-
-extern std::deque<uint64_t> RETIRE_BUFFER;
\ No newline at end of file
@@ -0,0 +1,226 @@
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <limits.h>
+#include <string>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Throughput and accuracy benchmark of procsim. Every trace is simulated over a
+// fixed configuration matrix; each run is timed (best of several repeats) and
+// its peak RSS recorded. Runs of the reference configuration are compared byte
+// for byte with the golden timelines in output1.1/. One CSV row per run goes to
+// the results file; the exit status is 1 if any golden timeline differs.
+
+static const char* const TRACES[] = { "gcc", "gobmk", "hmmer", "mcf" };
+
+// R, k0, k1, k2, F; the first is the configuration of the golden outputs
+static const uint64_t CONFIGS[][5] = {
+    { 2, 3, 2, 1, 4 },
+    { 8, 1, 2, 3, 4 },
+    { 4, 2, 2, 2, 8 },
+    { 16, 4, 4, 4, 8 },
+};
+
+typedef struct _bench_run_t
+{
+    uint64_t instructions;
+    uint64_t cycles;
+    double seconds;
+    long max_rss_kb;
+} bench_run_t;
+
+void print_help_and_exit(void) {
+    printf("procsim_bench [OPTIONS]\n");
+    printf("  -p file\tSimulator binary (default ./procsim)\n");
+    printf("  -t dir\tTrace directory, holding <name>.100k.trace (default traces)\n");
+    printf("  -g dir\tGolden timeline directory, holding <name>.output (default output1.1)\n");
+    printf("  -o file\tCSV results file (default bench.csv)\n");
+    printf("  -n N\t\tRepeats per run; the fastest counts (default 3)\n");
+    printf("  -h\t\tThis helpful output\n");
+    exit(0);
+}
+
+//
+// read_file
+//
+//  returns the whole content of path, or false if it cannot be read
+//
+static bool read_file(const std::string& path, std::string* content)
+{
+    FILE* f = fopen(path.c_str(), "rb");
+    if (f == NULL) return false;
+    content->clear();
+    char buf[1 << 16];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) content->append(buf, n);
+    fclose(f);
+    return true;
+}
+
+//
+// stat_value
+//
+//  returns the number after "label" in procsim's statistics output, 0 if missing
+//
+static uint64_t stat_value(const std::string& output, const char* label)
+{
+    size_t pos = output.find(label);
+    return (pos == std::string::npos) ? 0 : strtoull(output.c_str() + pos + strlen(label), NULL, 10);
+}
+
+//
+// run_once
+//
+//  runs procsim on trace in dir, with its stdout captured in dir/stdout;
+//  returns false if it could not be started or failed
+//
+static bool run_once(const char* procsim, const char* trace, const char* dir, const uint64_t config[5],
+                     bench_run_t* run)
+{
+    char args[5][32];
+    const char flags[5] = { 'r', 'j', 'k', 'l', 'f' };
+    for (int i = 0; i < 5; ++i) snprintf(args[i], sizeof(args[i]), "-%c%" PRIu64, flags[i], config[i]);
+
+    auto start = std::chrono::steady_clock::now();
+    pid_t pid = fork();
+    if (pid < 0) return false;
+    if (pid == 0) {
+        int in = open(trace, O_RDONLY);
+        if (in < 0 || chdir(dir) != 0) _exit(127);
+        int out = open("stdout", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        int null = open("/dev/null", O_WRONLY);
+        if (out < 0 || null < 0) _exit(127);
+        dup2(in, 0);
+        dup2(out, 1);
+        dup2(null, 2);
+        execl(procsim, procsim, args[0], args[1], args[2], args[3], args[4], (char*)NULL);
+        _exit(127);
+    }
+    int status;
+    struct rusage usage;
+    if (wait4(pid, &status, 0, &usage) != pid) return false;
+    run->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+#ifdef __APPLE__
+    run->max_rss_kb = usage.ru_maxrss / 1024;
+#else
+    run->max_rss_kb = usage.ru_maxrss;
+#endif
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) return false;
+
+    std::string output;
+    if (!read_file(std::string(dir) + "/stdout", &output)) return false;
+    run->instructions = stat_value(output, "Total instructions: ");
+    run->cycles = stat_value(output, "Total run time (cycles): ");
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    int opt;
+    const char* procsim_arg = "./procsim";
+    std::string trace_dir = "traces";
+    std::string golden_dir = "output1.1";
+    const char* out_path = "bench.csv";
+    int repeats = 3;
+
+    while(-1 != (opt = getopt(argc, argv, "p:t:g:o:n:h"))) {
+        switch(opt) {
+        case 'p':
+            procsim_arg = optarg;
+            break;
+        case 't':
+            trace_dir = optarg;
+            break;
+        case 'g':
+            golden_dir = optarg;
+            break;
+        case 'o':
+            out_path = optarg;
+            break;
+        case 'n':
+            repeats = atoi(optarg);
+            if (repeats < 1) print_help_and_exit();
+            break;
+        case 'h':
+            /* Fall through */
+        default:
+            print_help_and_exit();
+            break;
+        }
+    }
+
+    // The runs happen in a scratch directory, so the binary and traces need absolute paths
+    char procsim[PATH_MAX];
+    char traces[PATH_MAX];
+    if (realpath(procsim_arg, procsim) == NULL || realpath(trace_dir.c_str(), traces) == NULL) {
+        fprintf(stderr, "Cannot find %s or %s\n", procsim_arg, trace_dir.c_str());
+        return 1;
+    }
+    char scratch[] = "/tmp/procsim_bench.XXXXXX";
+    if (mkdtemp(scratch) == NULL) {
+        fprintf(stderr, "Cannot create a scratch directory\n");
+        return 1;
+    }
+    FILE* out = fopen(out_path, "w");
+    if (out == NULL) {
+        fprintf(stderr, "Failed to open %s for writing\n", out_path);
+        return 1;
+    }
+
+    fprintf(out, "trace,r,k0,k1,k2,f,instructions,cycles,seconds,kips,max_rss_kb,golden\n");
+    printf("%-6s %-14s %12s %10s %9s %10s %10s  %s\n", "trace", "R,k0,k1,k2,F", "instructions", "cycles",
+           "seconds", "KIPS", "RSS KB", "golden");
+    bool all_match = true;
+    bool failed = false;
+    for (const char* name : TRACES) {
+        std::string trace = std::string(traces) + "/" + name + ".100k.trace";
+        for (size_t c = 0; c < sizeof(CONFIGS) / sizeof(CONFIGS[0]); ++c) {
+            const uint64_t* config = CONFIGS[c];
+            bench_run_t best;
+            best.seconds = -1;
+            for (int i = 0; i < repeats; ++i) {
+                bench_run_t run;
+                if (!run_once(procsim, trace.c_str(), scratch, config, &run)) {
+                    fprintf(stderr, "procsim failed on %s\n", trace.c_str());
+                    failed = true;
+                    break;
+                }
+                if (best.seconds < 0 || run.seconds < best.seconds) best = run;
+            }
+            if (best.seconds < 0) continue;
+
+            // Only the first configuration has golden timelines
+            const char* golden = "none";
+            std::string expected, actual;
+            if (c == 0 && read_file(golden_dir + "/" + name + ".output", &expected)) {
+                bool same = read_file(std::string(scratch) + "/result_test.output", &actual) && actual == expected;
+                golden = same ? "match" : "differ";
+                all_match = all_match && same;
+            }
+
+            char config_str[64];
+            snprintf(config_str, sizeof(config_str), "%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64,
+                     config[0], config[1], config[2], config[3], config[4]);
+            double kips = best.instructions / best.seconds / 1e3;
+            fprintf(out, "%s,%s,%" PRIu64 ",%" PRIu64 ",%.4f,%.1f,%ld,%s\n", name, config_str, best.instructions,
+                    best.cycles, best.seconds, kips, best.max_rss_kb, golden);
+            printf("%-6s %-14s %12" PRIu64 " %10" PRIu64 " %9.4f %10.1f %10ld  %s\n", name, config_str,
+                   best.instructions, best.cycles, best.seconds, kips, best.max_rss_kb, golden);
+        }
+    }
+    fclose(out);
+
+    std::string scratch_dir = scratch;
+    unlink((scratch_dir + "/stdout").c_str());
+    unlink((scratch_dir + "/result_test.output").c_str());
+    rmdir(scratch);
+
+    if (!all_match) printf("Timelines differ from the golden outputs\n");
+    return (failed || !all_match) ? 1 : 0;
+}
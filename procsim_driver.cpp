@@ -1,11 +1,36 @@
+#include <algorithm>
 #include <cstdio>
 #include <cinttypes>
 #include <cstdlib>
 #include <cstring>
+#include <getopt.h>
 #include <unistd.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "dataflow.hpp"
+#include "multicore.hpp"
+#include "partition.hpp"
 #include "procsim.hpp"
+#include "sample.hpp"
+#include "sweep.hpp"
+#include "trace.hpp"
+#include "trace_cache.hpp"
+#include "trace_stream.hpp"
 
 FILE* inFile = stdin;
+static trace_reader_t trace_reader;
+
+// Fetch ring: instructions are decoded from the trace in batches and drained
+// one at a time by read_instruction(). Compressed and piped traces are decoded
+// on a background thread instead, and fetch_batch points into its ring.
+static trace_inst_t fetch_ring[TRACE_BATCH_SIZE];
+static const trace_inst_t* fetch_batch = fetch_ring;
+static trace_stream_t* trace_stream = NULL;
+static size_t fetch_ring_pos = 0;
+static size_t fetch_ring_len = 0;
+static bool trace_done = false;
 
 void print_help_and_exit(void) {
     printf("procsim [OPTIONS]\n");
@@ -14,11 +39,232 @@ void print_help_and_exit(void) {
     printf("  -l k2\t\tNumber of k2 FUs\n");   
     printf("  -f N\t\tNumber of instructions to fetch\n");
     printf("  -r R\t\tNumber of result buses\n");
-    printf("  -i traces/file.trace\n");
+    printf("  -i traces/file.trace\t(text or binary, optionally gzip/xz/zstd-compressed; default stdin)\n");
     printf("  -h\t\tThis helpful output\n");
+    printf("  --sweep\tSimulate a parameter grid and print CSV; -r/-j/-k/-l/-f\n");
+    printf("         \ttake lists (1,2,4) or ranges (1:5)\n");
+    printf("  -t N\t\tWorker threads for --sweep and --partition (default: one per core) or --multicore\n");
+    printf("      \t\t(default: one per simulated core, up to one per host core)\n");
+    printf("  --trace-cache DIR\tReuse (or create) a decoded copy of the -i trace in DIR\n");
+    printf("  --sample U:P[:W]\tSampled run: measure U of every P instructions after W warmup\n");
+    printf("  --simpoint U:K[:W]\tSampled run: one U-instruction interval per BBV cluster (K clusters)\n");
+    printf("  --partition K[:W]\tSplit the trace into K chunks simulated in parallel (-t threads), each\n");
+    printf("                   \tafter W warmup instructions, and stitch their statistics together\n");
+    printf("  --partition-check\tAlso run the trace serially and report the error of the stitched statistics\n");
+    printf("  --checkpoint FILE\tSave the pipeline state to FILE (see --checkpoint-at/-every)\n");
+    printf("  --checkpoint-at C\tSave the state at cycle C and stop\n");
+    printf("  --checkpoint-every N\tSave the state every N cycles\n");
+    printf("  --restore FILE\tResume from a checkpoint; -r/-j/-k/-l/-f fork it with new settings\n");
+    printf("  --no-idle-skip\tSimulate stalled cycles one by one instead of jumping over them\n");
+    printf("  --fu-latency L0,L1,L2\tCycles from issue to result per FU class (default 1,1,1)\n");
+    printf("  --fu-interval I0,I1,I2\tPipelined FUs accept an op every I cycles; 0 = held until\n");
+    printf("                        \tretire (default 0,0,0)\n");
+    printf("  --l1i S:A:B:L\tL1 I-cache of S bytes (k/m suffix), A ways, B-byte blocks, L-cycle hits\n");
+    printf("  --l1d S:A:B:L\tL1 D-cache, for trace instructions that carry a data address\n");
+    printf("  --l2 S:A:B:L\tUnified L2 behind both L1s\n");
+    printf("  --mem-latency N\tCycles for an access that misses every cache (default 100)\n");
+    printf("  --cache-only\tOnly run the trace through the caches and print their statistics\n");
+    printf("  --bp KIND[:BITS]\tBranch predictor: perfect (default), bimodal, gshare or tage,\n");
+    printf("                  \twith 2^BITS entries per table (default 12)\n");
+    printf("  --bp-penalty N\tCycles from resolving a mispredicted branch to fetching again (default 2)\n");
+    printf("  --bp-only\tOnly run the trace through the branch predictor and print its statistics\n");
+    printf("  --dataflow\tOnly analyze the register dataflow: critical path, IPC limit per window\n");
+    printf("            \tand the PCs on the critical path (uses --fu-latency)\n");
+    printf("  --dataflow-windows W1,W2,...\tWindow sizes for --dataflow (default 16,32,64,128,256,512)\n");
+    printf("  --output FILE\tTimeline file: text, or binary if FILE ends in .bin (default result_test.output);\n");
+    printf("               \tsee timeline_view for reading binary timelines\n");
+    printf("  --stats-every N\tWrite the change of every event counter over each N cycles\n");
+    printf("  --stats-file FILE\tFile for --stats-every: CSV, or binary if FILE ends in .bin\n");
+    printf("                   \t(default stats.csv)\n");
+    printf("  --profile\tReport host time per pipeline stage, queue occupancy and simulation speed\n");
+    printf("           \t(needs a build with profiling hooks: make profile)\n");
+    printf("  --multicore T1,T2,...\tSimulate one core per trace, all sharing the -j/-k/-l FUs\n");
+    printf("  --shared-cache\tWith --multicore: one cache hierarchy for all cores\n");
+    printf("  --config FILE\tRead options from FILE, one \"name value\" per line (e.g. \"r 4\",\n");
+    printf("               \t\"fu-latency 1,3,10\"); options on the command line take precedence\n");
     exit(0);
 }
 
+//
+// print_sample_statistics
+//
+static void print_sample_statistics(const sample_params_t& params, const sample_result_t& res)
+{
+    if (params.simpoint) {
+        printf("Sampled simulation: simpoint U=%" PRIu64 " K=%" PRIu64 " W=%" PRIu64 "\n",
+               params.unit, params.k, params.warmup);
+    } else {
+        printf("Sampled simulation: systematic U=%" PRIu64 " P=%" PRIu64 " W=%" PRIu64 "\n",
+               params.unit, params.period, params.warmup);
+    }
+    printf("Total instructions: %" PRIu64 "\n", res.total_instructions);
+    printf("Detailed instructions: %" PRIu64 " (%.2f%%)\n", res.detailed_instructions,
+           100.0 * res.detailed_instructions / res.total_instructions);
+    printf("Measured intervals: %" PRIu64 "\n", res.intervals);
+    if (params.simpoint) {
+        printf("Est inst retired per cycle: %f\n", res.ipc);
+    } else {
+        printf("Est inst retired per cycle: %f (95%% CI %f - %f)\n", res.ipc, res.ipc_low, res.ipc_high);
+    }
+    printf("Est total run time (cycles): %.0f\n", res.est_cycles);
+}
+
+//
+// print_partition_statistics
+//
+static void print_partition_statistics(const partition_params_t& params, const partition_result_t& res)
+{
+    const proc_stats_t& s = res.stats;
+    printf("Partitioned simulation: K=%" PRIu64 " W=%" PRIu64 "\n", params.chunks, params.warmup);
+    printf("Total instructions: %lu\n", s.retired_instruction);
+    printf("Detailed instructions: %" PRIu64 " (%.2f%%)\n", res.detailed_instructions,
+           100.0 * res.detailed_instructions / s.retired_instruction);
+    printf("Est avg Dispatch queue size: %f\n", s.avg_disp_size);
+    printf("Est maximum Dispatch queue size: %lu\n", s.max_disp_size);
+    printf("Est inst retired per cycle: %f\n", s.avg_inst_retired);
+    printf("Est total run time (cycles): %lu\n", s.cycle_count);
+    if (!params.check) return;
+
+    const proc_stats_t& serial = res.serial;
+    auto error = [](double est, double actual) { return actual ? 100.0 * (est - actual) / actual : 0.0; };
+    printf("Serial avg Dispatch queue size: %f (error %+.2f%%)\n", serial.avg_disp_size,
+           error(s.avg_disp_size, serial.avg_disp_size));
+    printf("Serial maximum Dispatch queue size: %lu (error %+.2f%%)\n", serial.max_disp_size,
+           error(s.max_disp_size, serial.max_disp_size));
+    printf("Serial inst retired per cycle: %f (error %+.2f%%)\n", serial.avg_inst_retired,
+           error(s.avg_inst_retired, serial.avg_inst_retired));
+    printf("Serial total run time (cycles): %lu (error %+.2f%%)\n", serial.cycle_count,
+           error(s.cycle_count, serial.cycle_count));
+}
+
+//
+// parse_fu_list
+//
+//  parses "a,b,c" into the three per-class values, each at least min
+//
+static bool parse_fu_list(const char* arg, uint64_t min, uint64_t values[3])
+{
+    const char* p = arg;
+    for (int c = 0; c < 3; ++c) {
+        char* end;
+        values[c] = strtoull(p, &end, 10);
+        if (end == p || values[c] < min) return false;
+        p = end;
+        if (c < 2 && *p++ != ',') return false;
+    }
+    return *p == '\0';
+}
+
+//
+// binary_path
+//
+//  whether an output file named path is written in binary: it ends in .bin
+//
+static bool binary_path(const std::string& path)
+{
+    return path.size() >= 4 && path.compare(path.size() - 4, 4, ".bin") == 0;
+}
+
+//
+// expand_config
+//
+//  returns argv with the options from every --config file inserted right after
+//  the program name, so that options given on the command line override them.
+//  A line "name value" becomes "-name value" for one-letter names and
+//  "--name value" otherwise; blank lines and lines starting with # are skipped.
+//
+static bool expand_config(int argc, char* argv[], std::vector<std::string>* storage, std::vector<char*>* args)
+{
+    std::vector<std::string> from_file;
+    for (int i = 1; i < argc; ++i) {
+        std::string path;
+        if (strcmp(argv[i], "--config") == 0 && i + 1 < argc) {
+            path = argv[++i];
+        } else if (strncmp(argv[i], "--config=", 9) == 0) {
+            path = argv[i] + 9;
+        } else {
+            continue;
+        }
+        std::ifstream file(path.c_str());
+        if (!file) {
+            fprintf(stderr, "Failed to open config file %s\n", path.c_str());
+            return false;
+        }
+        std::string line;
+        while (std::getline(file, line)) {
+            std::istringstream fields(line);
+            std::string name, value;
+            if (!(fields >> name) || name[0] == '#') continue;
+            from_file.push_back((name.size() == 1 ? "-" : "--") + name);
+            if (fields >> value) from_file.push_back(value);
+        }
+    }
+    storage->assign(1, argv[0]);
+    storage->insert(storage->end(), from_file.begin(), from_file.end());
+    storage->insert(storage->end(), argv + 1, argv + argc);
+    args->clear();
+    for (auto& s : *storage) args->push_back(&s[0]);
+    args->push_back(NULL);
+    return true;
+}
+
+//
+// load_trace
+//
+//  decodes the whole trace into memory, or maps an existing decoded copy from
+//  cache_dir (if given) and creates one there when it is missing
+//
+static void load_trace(const char* cache_dir, std::vector<trace_inst_t>* decoded, trace_cache_t* cache,
+                       const trace_inst_t** insts, size_t* count)
+{
+    uint64_t hash = 0;
+    bool cacheable = cache_dir != NULL && trace_content_hash(&trace_reader, &hash);
+    if (cache_dir != NULL && !cacheable) {
+        fprintf(stderr, "Trace cache needs a regular trace file; decoding without it\n");
+    }
+    if (cacheable && trace_cache_attach(cache_dir, hash, cache)) {
+        *insts = cache->insts;
+        *count = cache->count;
+        return;
+    }
+
+    size_t n;
+    do {
+        decoded->resize(decoded->size() + TRACE_BATCH_SIZE);
+        n = trace_next_batch(&trace_reader, &(*decoded)[decoded->size() - TRACE_BATCH_SIZE], TRACE_BATCH_SIZE);
+        decoded->resize(decoded->size() - TRACE_BATCH_SIZE + n);
+    } while (n > 0);
+    *insts = decoded->data();
+    *count = decoded->size();
+
+    if (cacheable && !trace_cache_store(cache_dir, hash, decoded->data(), decoded->size())) {
+        fprintf(stderr, "Failed to write the trace cache in %s\n", cache_dir);
+    }
+}
+
+//
+// run_sweep
+//
+//  simulates every grid point over the decoded trace on a thread pool
+//
+static int run_sweep(const trace_inst_t* insts, size_t count, const char* trace_name,
+                     const char* r_arg, const char* k0_arg, const char* k1_arg,
+                     const char* k2_arg, const char* f_arg, unsigned nthreads)
+{
+    std::vector<uint64_t> r, k0, k1, k2, f;
+    if (!sweep_parse_list(r_arg, &r) || !sweep_parse_list(k0_arg, &k0) || !sweep_parse_list(k1_arg, &k1) ||
+        !sweep_parse_list(k2_arg, &k2) || !sweep_parse_list(f_arg, &f)) {
+        fprintf(stderr, "Malformed sweep parameter list\n");
+        return 1;
+    }
+
+    std::vector<sweep_config_t> configs = sweep_grid(r, k0, k1, k2, f);
+    std::vector<sweep_result_t> results;
+    sweep_run(insts, count, configs, PROC, nthreads, &results);
+    sweep_write_csv(stdout, trace_name, results);
+    return 0;
+}
+
 //
 // read_instruction
 //
@@ -26,25 +272,140 @@ void print_help_and_exit(void) {
 //
 bool read_instruction(proc_inst_t* p_inst)
 {
-    int ret;
-    
     if (p_inst == NULL)
     {
         fprintf(stderr, "Fetch requires a valid pointer to populate\n");
         return false;
     }
     
-    ret = fscanf(stdin, "%x %d %d %d %d\n", &p_inst->instruction_address,
-                 &p_inst->op_code, &p_inst->dest_reg, &p_inst->src_reg[0], &p_inst->src_reg[1]); 
-    if (ret != 5) {
-        return false;
+    if (fetch_ring_pos == fetch_ring_len) {
+        if (trace_done) return false;
+        if (trace_stream != NULL) {
+            fetch_ring_len = trace_stream_next(trace_stream, &fetch_batch);
+        } else {
+            fetch_ring_len = trace_next_batch(&trace_reader, fetch_ring, TRACE_BATCH_SIZE);
+        }
+        fetch_ring_pos = 0;
+        if (fetch_ring_len == 0) {
+            trace_done = true;
+            return false;
+        }
     }
-    
+    const trace_inst_t& inst = fetch_batch[fetch_ring_pos++];
+    p_inst->instruction_address = inst.instruction_address;
+    p_inst->op_code = inst.op_code;
+    p_inst->dest_reg = inst.dest_reg;
+    p_inst->src_reg[0] = inst.src_reg[0];
+    p_inst->src_reg[1] = inst.src_reg[1];
+    p_inst->data_address = inst.data_address;
     return true;
 }
 
 void print_statistics(proc_stats_t* p_stats);
 
+//
+// decode_trace_file
+//
+//  decodes the whole trace in path into insts; false if it cannot be read
+//
+static bool decode_trace_file(const char* path, std::vector<trace_inst_t>* insts)
+{
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) return false;
+    trace_reader_t* reader = new trace_reader_t();
+    bool ok = trace_open(reader, file);
+    if (ok) {
+        size_t n;
+        do {
+            insts->resize(insts->size() + TRACE_BATCH_SIZE);
+            n = trace_next_batch(reader, &(*insts)[insts->size() - TRACE_BATCH_SIZE], TRACE_BATCH_SIZE);
+            insts->resize(insts->size() - TRACE_BATCH_SIZE + n);
+        } while (n > 0);
+        trace_close(reader);
+    }
+    delete reader;
+    fclose(file);
+    return ok;
+}
+
+//
+// run_multicore
+//
+//  simulates one core per trace of the comma-separated list, over shared FUs
+//  and optionally a shared cache hierarchy; core i writes its timeline to the
+//  --output file with .core<i> inserted before its extension
+//  (result_test.core<i>.output by default)
+//
+static int run_multicore(const char* trace_list, bool shared_cache, uint64_t r, uint64_t k0, uint64_t k1,
+                         uint64_t k2, uint64_t f, unsigned nthreads)
+{
+    std::vector<std::string> names;
+    std::stringstream list(trace_list);
+    std::string name;
+    while (std::getline(list, name, ',')) {
+        if (!name.empty()) names.push_back(name);
+    }
+    if (names.empty()) {
+        fprintf(stderr, "--multicore needs at least one trace\n");
+        return 1;
+    }
+
+    std::vector<std::vector<trace_inst_t>> traces(names.size());
+    std::vector<proc_t*> cores;
+    for (size_t i = 0; i < names.size(); ++i) {
+        if (!decode_trace_file(names[i].c_str(), &traces[i])) {
+            fprintf(stderr, "Failed to read trace %s\n", names[i].c_str());
+            return 1;
+        }
+        proc_t* core = new proc_t();
+        core->copy_model(PROC);
+        core->TRACE = traces[i].data();
+        core->TRACE_LEN = traces[i].size();
+        size_t dot = PROC.OUTPUT_PATH.rfind('.');
+        size_t slash = PROC.OUTPUT_PATH.rfind('/');
+        if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) dot = PROC.OUTPUT_PATH.size();
+        core->OUTPUT_PATH = PROC.OUTPUT_PATH;
+        core->OUTPUT_PATH.insert(dot, ".core" + std::to_string(i));
+        core->OUTPUT_BINARY = PROC.OUTPUT_BINARY;
+        core->setup(r, k0, k1, k2, f);
+        cores.push_back(core);
+    }
+    mem_hier_t shared_mem;
+    mem_init(&shared_mem, PROC.MEM_CONFIG);
+
+    printf("Processor Settings\n");
+    printf("R: %" PRIu64 "\n", r);
+    printf("k0: %" PRIu64 "\n", k0);
+    printf("k1: %" PRIu64 "\n", k1);
+    printf("k2: %" PRIu64 "\n", k2);
+    printf("F: %"  PRIu64 "\n", f);
+    printf("Cores: %zu (shared FUs, %s caches)\n", cores.size(), shared_cache ? "shared" : "private");
+    printf("\n");
+
+    std::vector<proc_stats_t> stats;
+    multicore_run(cores, shared_cache ? &shared_mem : NULL, nthreads, &stats);
+
+    uint64_t total_instructions = 0;
+    uint64_t max_cycles = 0;
+    for (size_t i = 0; i < cores.size(); ++i) {
+        cores[i]->complete(&stats[i]);
+        printf("Core %zu: %s\n", i, names[i].c_str());
+        print_statistics(&stats[i]);
+        if (!shared_cache) mem_print_stats(stdout, &cores[i]->MEM);
+        bp_print_stats(stdout, &cores[i]->BP, stats[i].retired_instruction);
+        printf("\n");
+        total_instructions += stats[i].retired_instruction;
+        max_cycles = std::max<uint64_t>(max_cycles, stats[i].cycle_count);
+        delete cores[i];
+    }
+    if (shared_cache) mem_print_stats(stdout, &shared_mem);
+    printf("All cores:\n");
+    printf("Total instructions: %" PRIu64 "\n", total_instructions);
+    printf("Total inst retired per cycle: %f\n", static_cast<double>(total_instructions) / (max_cycles - 1));
+    printf("Total run time (cycles): %" PRIu64 "\n", max_cycles);
+    return 0;
+}
+
 int main(int argc, char* argv[]) {
     int opt;
     uint64_t f = DEFAULT_F;
@@ -52,27 +413,221 @@ int main(int argc, char* argv[]) {
     uint64_t k1 = DEFAULT_K1;
     uint64_t k2 = DEFAULT_K2;
     uint64_t r = DEFAULT_R;
+    bool sweep = false;
+    unsigned nthreads = 0;
+    const char* cache_dir = NULL;
+    bool sampled = false;
+    sample_params_t sample_params;
+    bool partitioned = false;
+    partition_params_t partition_params;
+    bool partition_check = false;
+    std::string trace_name = "stdin";
+    std::string r_arg = std::to_string(DEFAULT_R);
+    std::string k0_arg = std::to_string(DEFAULT_K0);
+    std::string k1_arg = std::to_string(DEFAULT_K1);
+    std::string k2_arg = std::to_string(DEFAULT_K2);
+    std::string f_arg = std::to_string(DEFAULT_F);
+    const char* restore_path = NULL;
+    bool cache_only = false;
+    bool bp_only = false;
+    bool dataflow = false;
+    std::vector<uint64_t> dataflow_windows(DF_DEFAULT_WINDOWS, DF_DEFAULT_WINDOWS + 6);
+    bool config_given = false;
+    std::string stats_path = "stats.csv";
+    const char* multicore_arg = NULL;
+    bool shared_cache = false;
+    static const struct option long_opts[] = {
+        { "sweep", no_argument, NULL, 'S' },
+        { "trace-cache", required_argument, NULL, 'C' },
+        { "sample", required_argument, NULL, 'P' },
+        { "simpoint", required_argument, NULL, 'K' },
+        { "checkpoint", required_argument, NULL, 'c' },
+        { "checkpoint-at", required_argument, NULL, 'a' },
+        { "checkpoint-every", required_argument, NULL, 'e' },
+        { "restore", required_argument, NULL, 'R' },
+        { "no-idle-skip", no_argument, NULL, 'N' },
+        { "fu-latency", required_argument, NULL, 'L' },
+        { "fu-interval", required_argument, NULL, 'I' },
+        { "config", required_argument, NULL, 'F' },
+        { "l1i", required_argument, NULL, '1' },
+        { "l1d", required_argument, NULL, '2' },
+        { "l2", required_argument, NULL, '3' },
+        { "mem-latency", required_argument, NULL, 'M' },
+        { "cache-only", no_argument, NULL, 'O' },
+        { "bp", required_argument, NULL, 'B' },
+        { "bp-penalty", required_argument, NULL, 'Y' },
+        { "bp-only", no_argument, NULL, 'W' },
+        { "dataflow", no_argument, NULL, 'A' },
+        { "dataflow-windows", required_argument, NULL, 'U' },
+        { "profile", no_argument, NULL, 'Q' },
+        { "stats-every", required_argument, NULL, 'E' },
+        { "stats-file", required_argument, NULL, 'D' },
+        { "output", required_argument, NULL, 'G' },
+        { "multicore", required_argument, NULL, 'X' },
+        { "partition", required_argument, NULL, 'Z' },
+        { "partition-check", no_argument, NULL, 'V' },
+        { "shared-cache", no_argument, NULL, 'H' },
+        { NULL, 0, NULL, 0 }
+    };
+
+    /* Options from --config files come first, so the command line overrides them */
+    std::vector<std::string> arg_storage;
+    std::vector<char*> args;
+    if (!expand_config(argc, argv, &arg_storage, &args)) {
+        return 1;
+    }
+    argc = static_cast<int>(args.size()) - 1;
+    argv = args.data();
 
     /* Read arguments */ 
-    while(-1 != (opt = getopt(argc, argv, "r:i:j:k:l:f:h"))) {
+    while(-1 != (opt = getopt_long(argc, argv, "r:i:j:k:l:f:t:h", long_opts, NULL))) {
         switch(opt) {
         case 'r':
             r = atoi(optarg);
+            config_given = true;
+            r_arg = optarg;
             break;
         case 'j':
             k0 = atoi(optarg);
+            config_given = true;
+            k0_arg = optarg;
             break;
         case 'k':
             k1 = atoi(optarg);
+            config_given = true;
+            k1_arg = optarg;
             break;
         case 'l':
             k2 = atoi(optarg);
+            config_given = true;
+            k2_arg = optarg;
             break;
         case 'f':
             f = atoi(optarg);
+            config_given = true;
+            f_arg = optarg;
+            break;
+        case 'S':
+            sweep = true;
+            break;
+        case 't':
+            nthreads = atoi(optarg);
+            break;
+        case 'C':
+            cache_dir = optarg;
+            break;
+        case 'P':
+        case 'K':
+            sampled = true;
+            if (!sample_parse(optarg, opt == 'K', &sample_params)) {
+                fprintf(stderr, "Malformed sampling parameters %s\n", optarg);
+                print_help_and_exit();
+            }
+            break;
+        case 'Z':
+            partitioned = true;
+            if (!partition_parse(optarg, &partition_params)) {
+                fprintf(stderr, "Malformed partition parameters %s\n", optarg);
+                print_help_and_exit();
+            }
+            break;
+        case 'V':
+            partition_check = true;
+            break;
+        case 'c':
+            PROC.CHECKPOINT_PATH = optarg;
+            break;
+        case 'a':
+            PROC.CHECKPOINT_AT = strtoull(optarg, NULL, 10);
+            break;
+        case 'e':
+            PROC.CHECKPOINT_EVERY = strtoull(optarg, NULL, 10);
+            break;
+        case 'R':
+            restore_path = optarg;
+            break;
+        case 'N':
+            PROC.SKIP_IDLE = false;
+            break;
+        case 'L':
+            if (!parse_fu_list(optarg, 1, PROC.FU_TIMING.latency)) {
+                fprintf(stderr, "Malformed FU latencies %s\n", optarg);
+                print_help_and_exit();
+            }
+            break;
+        case 'I':
+            if (!parse_fu_list(optarg, 0, PROC.FU_TIMING.interval)) {
+                fprintf(stderr, "Malformed FU initiation intervals %s\n", optarg);
+                print_help_and_exit();
+            }
+            break;
+        case 'F':
+            /* Already expanded by expand_config() */
+            break;
+        case '1':
+        case '2':
+        case '3': {
+            mem_config_t& mem = PROC.MEM_CONFIG;
+            cache_config_t* cache = (opt == '1') ? &mem.l1i : (opt == '2') ? &mem.l1d : &mem.l2;
+            if (!cache_parse(optarg, cache)) {
+                fprintf(stderr, "Malformed cache geometry %s\n", optarg);
+                print_help_and_exit();
+            }
+            break;
+        }
+        case 'M':
+            PROC.MEM_CONFIG.mem_latency = strtoull(optarg, NULL, 10);
+            break;
+        case 'O':
+            cache_only = true;
+            break;
+        case 'B':
+            if (!bp_parse(optarg, &PROC.BP_CONFIG)) {
+                fprintf(stderr, "Unknown branch predictor %s\n", optarg);
+                print_help_and_exit();
+            }
+            break;
+        case 'Y':
+            PROC.BP_CONFIG.penalty = strtoull(optarg, NULL, 10);
+            break;
+        case 'W':
+            bp_only = true;
+            break;
+        case 'A':
+            dataflow = true;
+            break;
+        case 'U':
+            if (!dataflow_parse_windows(optarg, &dataflow_windows)) {
+                fprintf(stderr, "Invalid --dataflow-windows %s\n", optarg);
+                print_help_and_exit();
+            }
+            break;
+        case 'E':
+            PROC.COUNTER_LOG.every = strtoull(optarg, NULL, 10);
+            break;
+        case 'D':
+            stats_path = optarg;
+            break;
+        case 'G':
+            PROC.OUTPUT_PATH = optarg;
+            PROC.OUTPUT_BINARY = binary_path(PROC.OUTPUT_PATH);
+            break;
+        case 'X':
+            multicore_arg = optarg;
+            break;
+        case 'H':
+            shared_cache = true;
+            break;
+        case 'Q':
+            if (!PROFILE_BUILD) {
+                fprintf(stderr, "--profile needs a build with profiling hooks (make profile)\n");
+                return 1;
+            }
+            PROC.PROFILE.enabled = true;
             break;
         case 'i':
-            inFile = fopen(optarg, "r");
+            trace_name = optarg;
+            inFile = fopen(optarg, "rb");
             if (inFile == NULL)
             {
                 fprintf(stderr, "Failed to open %s for reading\n", optarg);
@@ -87,6 +642,113 @@ int main(int argc, char* argv[]) {
         }
     }
 
+    /* Multicore runs read their own traces */
+    if (multicore_arg != NULL) {
+        if (sweep || sampled || partitioned || restore_path != NULL || !PROC.CHECKPOINT_PATH.empty() || PROC.COUNTER_LOG.every ||
+            PROC.PROFILE.enabled || cache_only || bp_only || dataflow) {
+            fprintf(stderr, "--multicore cannot be combined with sweeps, sampling, partitioning, checkpoints, --stats-every,\n"
+                            "--profile, --cache-only, --bp-only or --dataflow\n");
+            return 1;
+        }
+        return run_multicore(multicore_arg, shared_cache, r, k0, k1, k2, f, nthreads);
+    }
+
+    /* Detect the trace format (text or binary) */
+    if (!trace_open(&trace_reader, inFile)) {
+        return 1;
+    }
+
+    /* Cache-only fast path: no pipeline, just the memory side of every instruction */
+    if (cache_only) {
+        mem_hier_t mem;
+        mem_init(&mem, PROC.MEM_CONFIG);
+        uint64_t total = 0;
+        size_t n;
+        while ((n = trace_next_batch(&trace_reader, fetch_ring, TRACE_BATCH_SIZE)) > 0) {
+            mem_replay(&mem, fetch_ring, n);
+            total += n;
+        }
+        printf("Total instructions: %" PRIu64 "\n", total);
+        mem_print_stats(stdout, &mem);
+        trace_close(&trace_reader);
+        return 0;
+    }
+
+    /* Predictor-only fast path: every instruction resolved against its successor */
+    if (bp_only) {
+        branch_pred_t* bp = new branch_pred_t();
+        bp_init(bp, PROC.BP_CONFIG);
+        size_t n;
+        while ((n = trace_next_batch(&trace_reader, fetch_ring, TRACE_BATCH_SIZE)) > 0) {
+            bp_replay(bp, fetch_ring, n);
+        }
+        uint64_t total = bp->instructions + (bp->has_last ? 1 : 0);
+        printf("Total instructions: %" PRIu64 "\n", total);
+        bp_print_stats(stdout, bp, total);
+        delete bp;
+        trace_close(&trace_reader);
+        return 0;
+    }
+
+    /* Dataflow analysis: the register dependence graph, streamed without the pipeline */
+    if (dataflow) {
+        dataflow_t* df = new dataflow_t();
+        dataflow_init(df, PROC.FU_TIMING, dataflow_windows);
+        size_t n;
+        while ((n = trace_next_batch(&trace_reader, fetch_ring, TRACE_BATCH_SIZE)) > 0) {
+            dataflow_replay(df, fetch_ring, n);
+        }
+        printf("Total instructions: %" PRIu64 "\n", df->instructions);
+        dataflow_print_stats(stdout, df);
+        delete df;
+        trace_close(&trace_reader);
+        return 0;
+    }
+
+    /* Sweeps, sampled, partitioned and cached runs simulate from a fully decoded trace */
+    std::vector<trace_inst_t> decoded;
+    trace_cache_t cache;
+    memset(&cache, 0, sizeof(cache));
+    const trace_inst_t* insts = NULL;
+    size_t count = 0;
+    if (sweep || sampled || partitioned || cache_dir != NULL) {
+        load_trace(cache_dir, &decoded, &cache, &insts, &count);
+        PROC.TRACE = insts;
+        PROC.TRACE_LEN = count;
+    }
+
+    if (sweep) {
+        int ret = run_sweep(insts, count, trace_name.c_str(), r_arg.c_str(), k0_arg.c_str(), k1_arg.c_str(),
+                            k2_arg.c_str(), f_arg.c_str(), nthreads);
+        trace_cache_detach(&cache);
+        trace_close(&trace_reader);
+        return ret;
+    }
+
+    /* Traces that cannot be parsed in place are decoded in the background */
+    if (PROC.TRACE == NULL && (trace_reader.compression != TRACE_COMPRESSION_NONE || !trace_reader.mapped)) {
+        trace_stream = new trace_stream_t();
+        trace_stream_start(trace_stream, &trace_reader);
+    }
+
+    /* Resume from a checkpoint, optionally forking it with new settings */
+    if (restore_path != NULL) {
+        if (!PROC.restore_checkpoint(restore_path)) {
+            fprintf(stderr, "Failed to restore checkpoint %s (or it does not match the trace)\n", restore_path);
+            return 1;
+        }
+        if (!config_given) {
+            r = PROC.PROC_R;
+            k0 = PROC.PROC_K0;
+            k1 = PROC.PROC_K1;
+            k2 = PROC.PROC_K2;
+            f = PROC.PROC_F;
+        } else if (!PROC.reconfigure(r, k0, k1, k2, f)) {
+            fprintf(stderr, "Cannot fork the checkpoint: fewer FUs than are busy at its cycle\n");
+            return 1;
+        }
+    }
+
     printf("Processor Settings\n");
     printf("R: %" PRIu64 "\n", r);
     printf("k0: %" PRIu64 "\n", k0);
@@ -95,8 +757,48 @@ int main(int argc, char* argv[]) {
     printf("F: %"  PRIu64 "\n", f);
     printf("\n");
 
+    if (partitioned) {
+        partition_result_t res;
+        int ret = 0;
+        partition_params.check = partition_check;
+        if (partition_run(insts, count, partition_params, r, k0, k1, k2, f, PROC, nthreads, &res)) {
+            print_partition_statistics(partition_params, res);
+        } else {
+            fprintf(stderr, "Trace has fewer instructions than chunks\n");
+            ret = 1;
+        }
+        trace_cache_detach(&cache);
+        trace_close(&trace_reader);
+        return ret;
+    }
+
+    if (sampled) {
+        sample_result_t res;
+        int ret = 0;
+        if (sample_run(insts, count, sample_params, r, k0, k1, k2, f, PROC, &res)) {
+            print_sample_statistics(sample_params, res);
+        } else {
+            fprintf(stderr, "Trace is too short for the sampling parameters\n");
+            ret = 1;
+        }
+        trace_cache_detach(&cache);
+        trace_close(&trace_reader);
+        return ret;
+    }
+
     /* Setup the processor */
-    setup_proc(r, k0, k1, k2, f);
+    if (restore_path == NULL) {
+        setup_proc(r, k0, k1, k2, f);
+    }
+
+    /* Interval counter log; a restored run writes the intervals after its checkpoint */
+    if (PROC.COUNTER_LOG.every) {
+        PROC.COUNTER_LOG.binary = binary_path(stats_path);
+        if (!counter_log_open(&PROC.COUNTER_LOG, stats_path.c_str())) {
+            fprintf(stderr, "Failed to create %s\n", stats_path.c_str());
+            return 1;
+        }
+    }
 
     /* Setup statistics */
     proc_stats_t stats;
@@ -104,11 +806,25 @@ int main(int argc, char* argv[]) {
 
     /* Run the processor */
     run_proc(&stats);
+    if (PROC.STOPPED) {
+        printf("Checkpoint written at cycle %" PRIu64 " to %s\n", PROC.CYCLE, PROC.CHECKPOINT_PATH.c_str());
+        if (trace_stream != NULL) trace_stream_stop(trace_stream);
+        trace_cache_detach(&cache);
+        trace_close(&trace_reader);
+        return 0;
+    }
 
     /* Finalize stats */
     complete_proc(&stats);
 
     print_statistics(&stats);
+    mem_print_stats(stdout, &PROC.MEM);
+    bp_print_stats(stdout, &PROC.BP, stats.retired_instruction);
+    if (PROC.PROFILE.enabled) profile_print(stdout, &PROC.PROFILE);
+
+    if (trace_stream != NULL) trace_stream_stop(trace_stream);
+    trace_cache_detach(&cache);
+    trace_close(&trace_reader);
 
     return 0;
 }
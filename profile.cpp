@@ -0,0 +1,62 @@
+#include <chrono>
+#include <cinttypes>
+#include <cstring>
+#include "profile.hpp"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+void profile_reset(proc_profile_t* prof)
+{
+    bool enabled = prof->enabled;
+    memset(prof, 0, sizeof(*prof));
+    prof->enabled = enabled;
+}
+
+uint64_t profile_ticks()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+double profile_seconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void profile_print(FILE* out, const proc_profile_t* prof)
+{
+    static const char* stage_names[PROF_STAGES] = { "update", "execute", "schedule", "dispatch", "fetch", "other" };
+    static const char* queue_names[PROF_QUEUES] = { "Dispatch queue", "Scheduling queue", "ROB" };
+    // Ticks are converted to seconds at the rate measured over the whole run
+    double seconds_per_tick = prof->run_ticks ? prof->run_seconds / prof->run_ticks : 0.0;
+    uint64_t stage_total = 0;
+    for (int s = 0; s < PROF_STAGES; ++s) stage_total += prof->stage_ticks[s];
+
+    fprintf(out, "Profile:\n");
+    fprintf(out, "Host time in run(): %.3f s\n", prof->run_seconds);
+    for (int s = 0; s < PROF_STAGES; ++s) {
+        fprintf(out, "  %-9s %10.3f ms  %5.1f%%\n", stage_names[s], 1e3 * prof->stage_ticks[s] * seconds_per_tick,
+                stage_total ? 100.0 * prof->stage_ticks[s] / stage_total : 0.0);
+    }
+    fprintf(out, "Cycles simulated stage by stage: %" PRIu64 " of %" PRIu64 "\n", prof->loop_cycles,
+            prof->run_cycles);
+    if (prof->run_seconds > 0) {
+        fprintf(out, "Speed: %.1f KIPS, %.1f kcycles/s\n", prof->run_instructions / prof->run_seconds / 1e3,
+                prof->run_cycles / prof->run_seconds / 1e3);
+    }
+    for (int q = 0; q < PROF_QUEUES; ++q) {
+        fprintf(out, "%s occupancy (cycles):\n", queue_names[q]);
+        for (int b = 0; b < PROF_BUCKETS; ++b) {
+            uint64_t n = prof->occupancy[q][b];
+            if (n == 0) continue;
+            uint64_t lo = b ? (1ULL << (b - 1)) : 0;
+            uint64_t hi = b ? (1ULL << b) - 1 : 0;
+            fprintf(out, "  %8" PRIu64 " - %-8" PRIu64 " %12" PRIu64 "\n", lo, hi, n);
+        }
+    }
+}
@@ -0,0 +1,104 @@
+#ifndef PROFILE_HPP
+#define PROFILE_HPP
+
+#include <cstdint>
+#include <cstdio>
+
+// Host-side profile of the simulator itself: time spent in each pipeline stage,
+// occupancy histograms of the main queues and the simulation speed. The timing
+// hooks in the run loop only exist in builds with PROCSIM_PROFILE defined
+// (make profile); without it they compile to nothing and --profile is refused.
+enum prof_stage_t
+{
+    PROF_UPDATE,
+    PROF_EXECUTE,
+    PROF_SCHEDULE,
+    PROF_DISPATCH,
+    PROF_FETCH,
+    PROF_OTHER,               // Deletions, idle skipping, checkpoints, progress output
+    PROF_STAGES
+};
+
+enum prof_queue_t
+{
+    PROF_DISPATCH_Q,
+    PROF_SCHED_Q,
+    PROF_ROB,
+    PROF_QUEUES
+};
+
+// Occupancy n falls in bucket 0 if n == 0, else in bucket floor(log2(n)) + 1
+#define PROF_BUCKETS 34
+
+typedef struct _proc_profile_t
+{
+    bool enabled;
+    uint64_t stage_ticks[PROF_STAGES];
+    uint64_t run_ticks;       // Ticks spent in run() overall
+    double run_seconds;       // Wall time spent in run() overall
+    uint64_t run_cycles;      // Cycles advanced by run(), skipped ones included
+    uint64_t run_instructions;    // Instructions retired by run()
+    uint64_t loop_cycles;     // Cycles simulated stage by stage
+    uint64_t occupancy[PROF_QUEUES][PROF_BUCKETS];   // Cycles at each occupancy
+} proc_profile_t;
+
+// Clear the counters, keeping `enabled`
+void profile_reset(proc_profile_t* prof);
+
+// Cheap monotonic tick counter (the TSC on x86, nanoseconds elsewhere)
+uint64_t profile_ticks();
+// Wall-clock seconds from an arbitrary origin
+double profile_seconds();
+
+// Count `cycles` cycles at the given occupancy of queue q
+inline void profile_occupancy(proc_profile_t* prof, int q, uint64_t n, uint64_t cycles) {
+    prof->occupancy[q][n ? 64 - __builtin_clzll(n) : 0] += cycles;
+}
+
+// Print the stage breakdown, the simulation speed and the occupancy histograms
+void profile_print(FILE* out, const proc_profile_t* prof);
+
+#ifdef PROCSIM_PROFILE
+#define PROFILE_BUILD 1
+#define PROFILE_START(prof, t) uint64_t t = (prof).enabled ? ((prof).loop_cycles++, profile_ticks()) : 0
+#define PROFILE_LAP(prof, stage, t)                                             \
+    do {                                                                        \
+        if ((prof).enabled) {                                                   \
+            uint64_t now_ = profile_ticks();                                    \
+            (prof).stage_ticks[stage] += now_ - (t);                            \
+            (t) = now_;                                                         \
+        }                                                                       \
+    } while (0)
+#define PROFILE_OCCUPANCY(prof, q, n, cycles)                                   \
+    do {                                                                        \
+        if ((prof).enabled) profile_occupancy(&(prof), q, n, cycles);           \
+    } while (0)
+// Bracket run(): the start values are subtracted and the end values added
+#define PROFILE_RUN_BEGIN(prof, cycle, retired)                                 \
+    do {                                                                        \
+        if ((prof).enabled) {                                                   \
+            (prof).run_ticks -= profile_ticks();                                \
+            (prof).run_seconds -= profile_seconds();                            \
+            (prof).run_cycles -= (cycle);                                       \
+            (prof).run_instructions -= (retired);                               \
+        }                                                                       \
+    } while (0)
+#define PROFILE_RUN_END(prof, cycle, retired)                                   \
+    do {                                                                        \
+        if ((prof).enabled) {                                                   \
+            (prof).run_ticks += profile_ticks();                                \
+            (prof).run_seconds += profile_seconds();                            \
+            (prof).run_cycles += (cycle);                                       \
+            (prof).run_instructions += (retired);                               \
+        }                                                                       \
+    } while (0)
+#else
+#define PROFILE_BUILD 0
+#define PROFILE_START(prof, t) do { } while (0)
+#define PROFILE_LAP(prof, stage, t) do { } while (0)
+#define PROFILE_OCCUPANCY(prof, q, n, cycles) do { } while (0)
+#define PROFILE_RUN_BEGIN(prof, cycle, retired) do { } while (0)
+#define PROFILE_RUN_END(prof, cycle, retired) do { } while (0)
+#endif
+
+#endif /* PROFILE_HPP */
@@ -0,0 +1,50 @@
+#include "procsim.hpp"
+#include "rob.hpp"
+
+void rob_t::clear()
+{
+    slots.assign(64, nullptr);
+    head = 0;
+    tail = 0;
+    count = 0;
+}
+
+void rob_t::push_back(proc_inst_t* p_inst)
+{
+    uint64_t t = p_inst->tag;
+    if (slots.empty()) slots.assign(64, nullptr);
+    if (count == 0) {
+        head = t;
+        tail = t;
+    }
+    while (t - head + 1 > slots.size()) {
+        // Re-place the live span into a ring twice the size
+        std::vector<proc_inst_t*> grown(slots.size() * 2, nullptr);
+        for (uint64_t i = head; i < tail; ++i) {
+            grown[i & (grown.size() - 1)] = slots[i & (slots.size() - 1)];
+        }
+        slots.swap(grown);
+    }
+    slots[t & (slots.size() - 1)] = p_inst;
+    tail = t + 1;
+    count++;
+}
+
+void rob_t::erase(uint64_t t)
+{
+    if (t < head || t >= tail || slots[t & (slots.size() - 1)] == nullptr) return;
+    slots[t & (slots.size() - 1)] = nullptr;
+    count--;
+    while (head < tail && slots[head & (slots.size() - 1)] == nullptr) head++;
+}
+
+std::vector<proc_inst_t*> rob_t::in_order() const
+{
+    std::vector<proc_inst_t*> insts;
+    insts.reserve(count);
+    for (uint64_t t = head; t < tail; ++t) {
+        proc_inst_t* inst = slots[t & (slots.size() - 1)];
+        if (inst != nullptr) insts.push_back(inst);
+    }
+    return insts;
+}
@@ -0,0 +1,40 @@
+#ifndef ROB_HPP
+#define ROB_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct _proc_inst_t;
+
+// Reorder buffer as a ring indexed by tag. Instructions are dispatched in tag
+// order, so the live entries always lie in [head, tail): an entry is looked up or
+// removed in O(1) by its tag, and removing the oldest one advances head past any
+// entries that already left out of order. Slots outside [head, tail) are empty.
+// The ring doubles when the span of live tags outgrows it.
+struct rob_t
+{
+    std::vector<struct _proc_inst_t*> slots;   // Power-of-two size; nullptr = removed
+    uint64_t head;            // Oldest tag still held
+    uint64_t tail;            // One past the newest tag
+    size_t count;
+
+    rob_t() : head(0), tail(0), count(0) {}
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    void clear();
+    // Append an instruction younger than every entry
+    void push_back(struct _proc_inst_t* p_inst);
+    // The entry with tag t, or nullptr if it is not held
+    struct _proc_inst_t* find(uint64_t t) const {
+        return (t >= head && t < tail) ? slots[t & (slots.size() - 1)] : nullptr;
+    }
+    // Remove the entry with tag t
+    void erase(uint64_t t);
+    // The held entries, oldest first
+    std::vector<struct _proc_inst_t*> in_order() const;
+};
+
+#endif /* ROB_HPP */
@@ -0,0 +1,222 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include "sample.hpp"
+
+// Number of hashed basic-block buckets in a BBV
+#define BBV_DIMS 32
+#define KMEANS_ITERATIONS 50
+
+bool sample_parse(const char* arg, bool simpoint, sample_params_t* params)
+{
+    memset(params, 0, sizeof(*params));
+    params->simpoint = simpoint;
+    uint64_t v[3] = { 0, 0, 0 };
+    int n = 0;
+    const char* p = arg;
+    while (n < 3) {
+        char* end;
+        v[n++] = strtoull(p, &end, 10);
+        if (end == p) return false;
+        p = end;
+        if (*p != ':') break;
+        ++p;
+    }
+    if (*p || n < 2 || v[0] == 0 || v[1] == 0) return false;
+    params->unit = v[0];
+    params->warmup = v[2];
+    if (simpoint) {
+        params->k = v[1];
+    } else {
+        params->period = v[1];
+        if (params->period < params->unit + params->warmup) return false;
+    }
+    return true;
+}
+
+// Helper: detailed simulation of `unit` instructions starting at `begin`, preceded
+// by up to `warmup` unmeasured ones; returns the measured cycles per instruction
+static double simulate_interval(proc_t* proc, const trace_inst_t* trace, size_t trace_len,
+                                uint64_t begin, const sample_params_t& params,
+                                uint64_t r, uint64_t k0, uint64_t k1, uint64_t k2, uint64_t f,
+                                uint64_t* detailed) {
+    uint64_t warm = std::min<uint64_t>(params.warmup, begin);
+    uint64_t len = std::min<uint64_t>(params.unit, trace_len - begin);
+    proc->TRACE = trace + (begin - warm);
+    proc->TRACE_LEN = warm + len;
+    proc->MEASURE_AFTER = warm;
+    proc->setup(r, k0, k1, k2, f);
+    proc_stats_t stats;
+    memset(&stats, 0, sizeof(stats));
+    proc->run(&stats);
+    *detailed += warm + len;
+
+    // Without warmup the interval runs from cycle 0, like a full run
+    uint64_t cycles = warm ? proc->LAST_RETIRE_CYCLE - proc->MEASURE_START_CYCLE : proc->LAST_RETIRE_CYCLE + 1;
+    return static_cast<double>(std::max<uint64_t>(cycles, 1)) / len;
+}
+
+// Helper: two-sided 95% Student t critical value for df degrees of freedom
+static double t_critical_95(uint64_t df) {
+    static const double table[] = { 0, 12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262,
+                                    2.228, 2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093,
+                                    2.086, 2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045,
+                                    2.042 };
+    if (df == 0) return 0;
+    if (df <= 30) return table[df];
+    return 1.96;
+}
+
+static bool run_systematic(proc_t* proc, const trace_inst_t* trace, size_t trace_len, const sample_params_t& params,
+                           uint64_t r, uint64_t k0, uint64_t k1, uint64_t k2, uint64_t f,
+                           sample_result_t* result) {
+    std::vector<double> cpi;
+    for (uint64_t begin = params.warmup; begin + params.unit <= trace_len; begin += params.period) {
+        cpi.push_back(simulate_interval(proc, trace, trace_len, begin, params, r, k0, k1, k2, f,
+                                        &result->detailed_instructions));
+    }
+    if (cpi.empty()) return false;
+
+    double mean = 0;
+    for (double c : cpi) mean += c;
+    mean /= cpi.size();
+    double var = 0;
+    for (double c : cpi) var += (c - mean) * (c - mean);
+    double half = 0;
+    if (cpi.size() > 1) {
+        var /= (cpi.size() - 1);
+        half = t_critical_95(cpi.size() - 1) * std::sqrt(var / cpi.size());
+    }
+
+    result->intervals = cpi.size();
+    result->ipc = 1.0 / mean;
+    result->ipc_low = 1.0 / (mean + half);
+    result->ipc_high = (mean - half > 0) ? 1.0 / (mean - half) : INFINITY;
+    result->est_cycles = mean * trace_len;
+    return true;
+}
+
+// Helper: basic block vector of trace[begin, begin + len), L1-normalized. A new
+// block starts wherever the PC does not follow on from the previous instruction.
+static void basic_block_vector(const trace_inst_t* trace, uint64_t begin, uint64_t len, double* bbv) {
+    std::fill(bbv, bbv + BBV_DIMS, 0.0);
+    uint32_t block_pc = trace[begin].instruction_address;
+    for (uint64_t i = begin; i < begin + len; ++i) {
+        if (i > 0 && trace[i].instruction_address != trace[i - 1].instruction_address + 4) {
+            block_pc = trace[i].instruction_address;
+        }
+        uint32_t bucket = ((block_pc >> 2) * 0x9e3779b1u) >> 27;
+        bbv[bucket] += 1.0;
+    }
+    for (int d = 0; d < BBV_DIMS; ++d) bbv[d] /= len;
+}
+
+static double distance2(const double* a, const double* b) {
+    double d = 0;
+    for (int i = 0; i < BBV_DIMS; ++i) d += (a[i] - b[i]) * (a[i] - b[i]);
+    return d;
+}
+
+static bool run_simpoint(proc_t* proc, const trace_inst_t* trace, size_t trace_len, const sample_params_t& params,
+                         uint64_t r, uint64_t k0, uint64_t k1, uint64_t k2, uint64_t f,
+                         sample_result_t* result) {
+    size_t n = trace_len / params.unit;
+    if (n == 0) return false;
+    size_t k = std::min<size_t>(params.k, n);
+
+    std::vector<double> bbv(n * BBV_DIMS);
+    for (size_t i = 0; i < n; ++i) {
+        basic_block_vector(trace, i * params.unit, params.unit, &bbv[i * BBV_DIMS]);
+    }
+
+    // k-means++ seeding with a fixed seed, so results are reproducible
+    std::mt19937_64 rng(1);
+    std::vector<double> centroid(k * BBV_DIMS);
+    std::vector<double> nearest(n, INFINITY);
+    size_t first = rng() % n;
+    std::copy(&bbv[first * BBV_DIMS], &bbv[first * BBV_DIMS] + BBV_DIMS, &centroid[0]);
+    for (size_t c = 1; c < k; ++c) {
+        double total = 0;
+        for (size_t i = 0; i < n; ++i) {
+            nearest[i] = std::min(nearest[i], distance2(&bbv[i * BBV_DIMS], &centroid[(c - 1) * BBV_DIMS]));
+            total += nearest[i];
+        }
+        double pick = std::uniform_real_distribution<double>(0, total)(rng);
+        size_t chosen = n - 1;
+        for (size_t i = 0; i < n; ++i) {
+            pick -= nearest[i];
+            if (pick <= 0) { chosen = i; break; }
+        }
+        std::copy(&bbv[chosen * BBV_DIMS], &bbv[chosen * BBV_DIMS] + BBV_DIMS, &centroid[c * BBV_DIMS]);
+    }
+
+    // Lloyd iterations
+    std::vector<size_t> member(n, 0);
+    for (int iter = 0; iter < KMEANS_ITERATIONS; ++iter) {
+        bool changed = false;
+        for (size_t i = 0; i < n; ++i) {
+            size_t best = 0;
+            double best_d = INFINITY;
+            for (size_t c = 0; c < k; ++c) {
+                double d = distance2(&bbv[i * BBV_DIMS], &centroid[c * BBV_DIMS]);
+                if (d < best_d) { best_d = d; best = c; }
+            }
+            if (member[i] != best || iter == 0) changed = true;
+            member[i] = best;
+        }
+        if (!changed) break;
+        std::vector<size_t> size(k, 0);
+        std::fill(centroid.begin(), centroid.end(), 0.0);
+        for (size_t i = 0; i < n; ++i) {
+            size[member[i]]++;
+            for (int d = 0; d < BBV_DIMS; ++d) centroid[member[i] * BBV_DIMS + d] += bbv[i * BBV_DIMS + d];
+        }
+        for (size_t c = 0; c < k; ++c) {
+            if (size[c] == 0) continue;
+            for (int d = 0; d < BBV_DIMS; ++d) centroid[c * BBV_DIMS + d] /= size[c];
+        }
+    }
+
+    // Simulate the interval closest to each centroid, weighted by cluster size
+    double cpi = 0;
+    for (size_t c = 0; c < k; ++c) {
+        size_t rep = n;
+        size_t size = 0;
+        double best_d = INFINITY;
+        for (size_t i = 0; i < n; ++i) {
+            if (member[i] != c) continue;
+            size++;
+            double d = distance2(&bbv[i * BBV_DIMS], &centroid[c * BBV_DIMS]);
+            if (d < best_d) { best_d = d; rep = i; }
+        }
+        if (size == 0) continue;
+        cpi += simulate_interval(proc, trace, trace_len, rep * params.unit, params, r, k0, k1, k2, f,
+                                 &result->detailed_instructions) * size / n;
+        result->intervals++;
+    }
+
+    result->ipc = 1.0 / cpi;
+    result->ipc_low = result->ipc;
+    result->ipc_high = result->ipc;
+    result->est_cycles = cpi * trace_len;
+    return true;
+}
+
+bool sample_run(const trace_inst_t* trace, size_t trace_len, const sample_params_t& params,
+                uint64_t r, uint64_t k0, uint64_t k1, uint64_t k2, uint64_t f,
+                const proc_t& model, sample_result_t* result)
+{
+    memset(result, 0, sizeof(*result));
+    result->total_instructions = trace_len;
+
+    proc_t* proc = new proc_t();
+    proc->copy_model(model);
+    proc->OUTPUT_PATH.clear();
+    proc->PROGRESS = false;
+    bool ok = params.simpoint ? run_simpoint(proc, trace, trace_len, params, r, k0, k1, k2, f, result)
+                              : run_systematic(proc, trace, trace_len, params, r, k0, k1, k2, f, result);
+    delete proc;
+    return ok;
+}
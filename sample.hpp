@@ -0,0 +1,52 @@
+#ifndef SAMPLE_HPP
+#define SAMPLE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "procsim.hpp"
+
+// Sampled simulation over a decoded trace. Only short detailed intervals are
+// simulated; the instructions between them are fast-forwarded. Each interval
+// starts from an empty pipeline and its first `warmup` instructions fill the
+// window before measurement begins. The producer table holds only in-flight
+// instructions, so fast-forwarding leaves no functional state to warm.
+//
+//  systematic: measure `unit` instructions out of every `period`, and report the
+//              IPC with a 95% confidence interval over the units
+//  simpoint:   split the trace into `unit`-sized intervals, cluster their basic
+//              block vectors (blocks inferred from PC discontinuities) into `k`
+//              groups, and measure one representative per group weighted by its size
+
+typedef struct _sample_params_t
+{
+    bool simpoint;
+    uint64_t unit;            // Measured instructions per interval
+    uint64_t period;          // systematic: instructions between interval starts
+    uint64_t k;               // simpoint: number of clusters
+    uint64_t warmup;          // Detailed but unmeasured instructions before each interval
+} sample_params_t;
+
+typedef struct _sample_result_t
+{
+    uint64_t total_instructions;
+    uint64_t detailed_instructions;  // Simulated in detail, warmup included
+    uint64_t intervals;
+    double ipc;
+    double ipc_low;                  // 95% confidence interval (systematic only)
+    double ipc_high;
+    double est_cycles;
+} sample_result_t;
+
+// Parse "U:P[:W]" (systematic) or "U:K[:W]" (simpoint); false if malformed
+bool sample_parse(const char* arg, bool simpoint, sample_params_t* params);
+
+// Run the sampled simulation of configuration (r, k0, k1, k2, f) with the model
+// settings of `model`; false if the trace is too short for the parameters.
+// Caches and predictor tables start cold in every interval, so warmup should
+// cover their refill.
+bool sample_run(const trace_inst_t* trace, size_t trace_len, const sample_params_t& params,
+                uint64_t r, uint64_t k0, uint64_t k1, uint64_t k2, uint64_t f,
+                const proc_t& model, sample_result_t* result);
+
+#endif /* SAMPLE_HPP */
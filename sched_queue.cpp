@@ -0,0 +1,74 @@
+#include <algorithm>
+#include "procsim.hpp"
+#include "sched_queue.hpp"
+
+void sched_queue_t::clear()
+{
+    inst.clear();
+    tag.clear();
+    for (int c = 0; c < 3; ++c) ready[c].clear();
+    unissued = 0;
+}
+
+void sched_queue_t::push_back(proc_inst_t* p_inst)
+{
+    if ((inst.size() & 63) == 0) {
+        for (int c = 0; c < 3; ++c) ready[c].push_back(0);
+    }
+    inst.push_back(p_inst);
+    tag.push_back(p_inst->tag);
+    if (!p_inst->issued) unissued++;
+}
+
+size_t sched_queue_t::find(uint64_t t) const
+{
+    std::vector<uint64_t>::const_iterator it = std::lower_bound(tag.begin(), tag.end(), t);
+    return (it != tag.end() && *it == t) ? static_cast<size_t>(it - tag.begin()) : tag.size();
+}
+
+void sched_queue_t::erase(size_t pos)
+{
+    inst.erase(inst.begin() + pos);
+    tag.erase(tag.begin() + pos);
+    // Drop bit pos from every mask and move the bits above it down by one
+    size_t word = pos >> 6;
+    uint64_t low = (1ULL << (pos & 63)) - 1;
+    size_t words = (inst.size() + 63) >> 6;
+    for (int c = 0; c < 3; ++c) {
+        std::vector<uint64_t>& mask = ready[c];
+        mask[word] = (mask[word] & low) | ((mask[word] >> 1) & ~low);
+        for (size_t i = word + 1; i < mask.size(); ++i) {
+            mask[i - 1] |= (mask[i] & 1) << 63;
+            mask[i] >>= 1;
+        }
+        mask.resize(words);
+    }
+}
+
+bool sched_queue_t::any_ready(int cls) const
+{
+    for (uint64_t w : ready[cls]) {
+        if (w) return true;
+    }
+    return false;
+}
+
+size_t sched_queue_t::ready_count(int cls) const
+{
+    size_t n = 0;
+    for (uint64_t w : ready[cls]) n += __builtin_popcountll(w);
+    return n;
+}
+
+proc_inst_t* sched_queue_t::pop_oldest_ready(int cls)
+{
+    std::vector<uint64_t>& mask = ready[cls];
+    for (size_t i = 0; i < mask.size(); ++i) {
+        if (mask[i] == 0) continue;
+        unsigned bit = __builtin_ctzll(mask[i]);
+        mask[i] &= mask[i] - 1;
+        unissued--;
+        return inst[(i << 6) + bit];
+    }
+    return nullptr;
+}
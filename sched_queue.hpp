@@ -0,0 +1,46 @@
+#ifndef SCHED_QUEUE_HPP
+#define SCHED_QUEUE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct _proc_inst_t;
+
+// Scheduling queue (reservation stations) stored as parallel arrays. Entries are
+// kept in age order: instructions enter in tag order at the back and leaving ones
+// are compacted out, so the tag array stays sorted and an entry is found by binary
+// search. Each FU class has a bitmask over entry positions marking the scheduled,
+// unissued instructions with both operands ready; the oldest of them is the lowest
+// set bit, found one 64-entry word at a time.
+struct sched_queue_t
+{
+    std::vector<struct _proc_inst_t*> inst;
+    std::vector<uint64_t> tag;
+    std::vector<uint64_t> ready[3];   // One bit per position, ceil(size / 64) words
+    size_t unissued;                  // Entries not yet taken by pop_oldest_ready()
+
+    sched_queue_t() : unissued(0) {}
+
+    size_t size() const { return inst.size(); }
+    bool empty() const { return inst.empty(); }
+    struct _proc_inst_t* operator[](size_t pos) const { return inst[pos]; }
+    std::vector<struct _proc_inst_t*>::const_iterator begin() const { return inst.begin(); }
+    std::vector<struct _proc_inst_t*>::const_iterator end() const { return inst.end(); }
+
+    void clear();
+    // Append an instruction younger than every entry
+    void push_back(struct _proc_inst_t* p_inst);
+    // Position of the entry with tag t, or size() if there is none
+    size_t find(uint64_t t) const;
+    // Remove the entry at pos, keeping the others in order
+    void erase(size_t pos);
+
+    void set_ready(size_t pos, int cls) { ready[cls][pos >> 6] |= 1ULL << (pos & 63); }
+    bool any_ready(int cls) const;
+    size_t ready_count(int cls) const;
+    // Take the oldest ready instruction of class cls off its mask; nullptr if none
+    struct _proc_inst_t* pop_oldest_ready(int cls);
+};
+
+#endif /* SCHED_QUEUE_HPP */
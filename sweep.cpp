@@ -0,0 +1,138 @@
+#include <cinttypes>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include "sweep.hpp"
+
+bool sweep_parse_list(const char* arg, std::vector<uint64_t>* values)
+{
+    values->clear();
+    const char* p = arg;
+    while (*p) {
+        char* end;
+        uint64_t lo = strtoull(p, &end, 10);
+        if (end == p) return false;
+        uint64_t hi = lo;
+        p = end;
+        if (*p == ':') {
+            hi = strtoull(p + 1, &end, 10);
+            if (end == p + 1 || hi < lo) return false;
+            p = end;
+        }
+        for (uint64_t v = lo; v <= hi; ++v) {
+            values->push_back(v);
+        }
+        if (*p == ',') {
+            ++p;
+        } else if (*p) {
+            return false;
+        }
+    }
+    return !values->empty();
+}
+
+std::vector<sweep_config_t> sweep_grid(const std::vector<uint64_t>& r, const std::vector<uint64_t>& k0,
+                                       const std::vector<uint64_t>& k1, const std::vector<uint64_t>& k2,
+                                       const std::vector<uint64_t>& f)
+{
+    std::vector<sweep_config_t> configs;
+    for (uint64_t vr : r)
+        for (uint64_t v0 : k0)
+            for (uint64_t v1 : k1)
+                for (uint64_t v2 : k2)
+                    for (uint64_t vf : f) {
+                        sweep_config_t c = { vr, v0, v1, v2, vf };
+                        configs.push_back(c);
+                    }
+    return configs;
+}
+
+// Work-stealing queue of configuration indices: a worker takes jobs from the
+// front of its own queue and steals from the back of the others' when it runs dry
+typedef struct _sweep_queue_t
+{
+    std::mutex lock;
+    std::deque<size_t> jobs;
+} sweep_queue_t;
+
+static bool take_job(std::vector<sweep_queue_t>& queues, unsigned self, size_t* job) {
+    {
+        std::lock_guard<std::mutex> guard(queues[self].lock);
+        if (!queues[self].jobs.empty()) {
+            *job = queues[self].jobs.front();
+            queues[self].jobs.pop_front();
+            return true;
+        }
+    }
+    for (size_t i = 1; i < queues.size(); ++i) {
+        sweep_queue_t& victim = queues[(self + i) % queues.size()];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if (!victim.jobs.empty()) {
+            *job = victim.jobs.back();
+            victim.jobs.pop_back();
+            return true;
+        }
+    }
+    // No job is ever added after the start, so an empty scan means we are done
+    return false;
+}
+
+static void sweep_worker(const trace_inst_t* trace, size_t trace_len, const std::vector<sweep_config_t>* configs,
+                         const proc_t* model, std::vector<sweep_queue_t>* queues, unsigned self,
+                         std::vector<sweep_result_t>* results) {
+    proc_t* proc = new proc_t();
+    proc->copy_model(*model);
+    proc->TRACE = trace;
+    proc->TRACE_LEN = trace_len;
+    proc->OUTPUT_PATH.clear();
+    proc->PROGRESS = false;
+    size_t job;
+    while (take_job(*queues, self, &job)) {
+        const sweep_config_t& c = (*configs)[job];
+        sweep_result_t& res = (*results)[job];
+        memset(&res.stats, 0, sizeof(res.stats));
+        res.config = c;
+        proc->setup(c.r, c.k0, c.k1, c.k2, c.f);
+        proc->run(&res.stats);
+        proc->complete(&res.stats);
+    }
+    delete proc;
+}
+
+void sweep_run(const trace_inst_t* trace, size_t trace_len, const std::vector<sweep_config_t>& configs,
+               const proc_t& model, unsigned nthreads, std::vector<sweep_result_t>* results)
+{
+    if (nthreads == 0) nthreads = std::thread::hardware_concurrency();
+    if (nthreads == 0) nthreads = 1;
+    if (nthreads > configs.size()) nthreads = configs.size() ? configs.size() : 1;
+
+    results->assign(configs.size(), sweep_result_t());
+    std::vector<sweep_queue_t> queues(nthreads);
+    for (size_t i = 0; i < configs.size(); ++i) {
+        queues[i % nthreads].jobs.push_back(i);
+    }
+
+    std::vector<std::thread> workers;
+    for (unsigned t = 1; t < nthreads; ++t) {
+        workers.push_back(std::thread(sweep_worker, trace, trace_len, &configs, &model, &queues, t, results));
+    }
+    sweep_worker(trace, trace_len, &configs, &model, &queues, 0, results);
+    for (auto& w : workers) {
+        w.join();
+    }
+}
+
+void sweep_write_csv(FILE* out, const char* trace_name, const std::vector<sweep_result_t>& results)
+{
+    fprintf(out, "trace,R,k0,k1,k2,F,instructions,cycles,IPC,avg_disp_size,max_disp_size,avg_inst_fired,avg_inst_retired\n");
+    for (const auto& res : results) {
+        const sweep_config_t& c = res.config;
+        const proc_stats_t& s = res.stats;
+        fprintf(out, "%s,%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%lu,%lu,%f,%f,%lu,%f,%f\n",
+                trace_name, c.r, c.k0, c.k1, c.k2, c.f,
+                s.retired_instruction, s.cycle_count - 1, s.avg_inst_retired,
+                s.avg_disp_size, s.max_disp_size, s.avg_inst_fired, s.avg_inst_retired);
+    }
+}
@@ -0,0 +1,43 @@
+#ifndef SWEEP_HPP
+#define SWEEP_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include "procsim.hpp"
+
+// One point of a parameter sweep
+typedef struct _sweep_config_t
+{
+    uint64_t r;
+    uint64_t k0;
+    uint64_t k1;
+    uint64_t k2;
+    uint64_t f;
+} sweep_config_t;
+
+typedef struct _sweep_result_t
+{
+    sweep_config_t config;
+    proc_stats_t stats;
+} sweep_result_t;
+
+// Parse a parameter list: "4", "1,2,4" or an inclusive range "1:5"; false if malformed
+bool sweep_parse_list(const char* arg, std::vector<uint64_t>* values);
+
+// Cartesian product of the per-parameter value lists, R varying slowest
+std::vector<sweep_config_t> sweep_grid(const std::vector<uint64_t>& r, const std::vector<uint64_t>& k0,
+                                       const std::vector<uint64_t>& k1, const std::vector<uint64_t>& k2,
+                                       const std::vector<uint64_t>& f);
+
+// Simulate every configuration over the shared, read-only decoded trace (possibly a
+// mapped trace cache entry) on nthreads worker threads (0 = one per hardware
+// thread). Every run takes its model settings (FU timing, caches, branch
+// predictor) from `model`. results[i] belongs to configs[i].
+void sweep_run(const trace_inst_t* trace, size_t trace_len, const std::vector<sweep_config_t>& configs,
+               const proc_t& model, unsigned nthreads, std::vector<sweep_result_t>* results);
+
+// Write results as CSV, one row per configuration
+void sweep_write_csv(FILE* out, const char* trace_name, const std::vector<sweep_result_t>& results);
+
+#endif /* SWEEP_HPP */
@@ -0,0 +1,273 @@
+#include <algorithm>
+#include <cstring>
+#include "timeline.hpp"
+
+// Sizes of the fixed-size parts of the format
+static const uint64_t HEADER_BYTES = 8 + 6 * 8;
+static const uint64_t BLOCK_HEADER_BYTES = 10 * 8;
+static const uint64_t INDEX_ENTRY_BYTES = 11 * 8;
+static const uint64_t STATS_BYTES = 6 * 8;
+static const uint64_t FOOTER_BYTES = 2 * 8 + 8;
+
+// Helper: write a uint64 to the timeline
+static void put_u64(std::ofstream& f, uint64_t v) {
+    f.write(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+// Helper: read a uint64 from the timeline
+static bool get_u64(FILE* f, uint64_t* v) {
+    return fread(v, sizeof(*v), 1, f) == 1;
+}
+
+// Helper: append v as a zigzag varint, so small negative deltas stay short too
+static void put_varint(std::vector<uint8_t>* out, uint64_t v) {
+    uint64_t z = (v << 1) ^ static_cast<uint64_t>(static_cast<int64_t>(v) >> 63);
+    while (z >= 0x80) {
+        out->push_back(static_cast<uint8_t>(z) | 0x80);
+        z >>= 7;
+    }
+    out->push_back(static_cast<uint8_t>(z));
+}
+
+// Helper: decode the zigzag varint at *p, not reading past end
+static bool get_varint(const uint8_t** p, const uint8_t* end, uint64_t* v) {
+    uint64_t z = 0;
+    for (int shift = 0; *p < end && shift < 64; shift += 7) {
+        uint8_t byte = *(*p)++;
+        z |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            *v = (z >> 1) ^ (0 - (z & 1));
+            return true;
+        }
+    }
+    return false;
+}
+
+// Helper: the stored form of a float statistic
+static uint64_t float_bits(float v) {
+    uint32_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    return bits;
+}
+
+static float bits_float(uint64_t v) {
+    uint32_t bits = static_cast<uint32_t>(v);
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+// Helper: read and check the header; settings may be null
+static bool read_header(FILE* f, uint64_t settings[5]) {
+    char magic[8];
+    uint64_t version = 0, s[5];
+    bool ok = fread(magic, 8, 1, f) == 1 && memcmp(magic, TIMELINE_MAGIC, 8) == 0 &&
+              get_u64(f, &version) && version == TIMELINE_VERSION;
+    for (int i = 0; ok && i < 5; ++i) ok = get_u64(f, &s[i]);
+    if (ok && settings != NULL) memcpy(settings, s, sizeof(s));
+    return ok;
+}
+
+// Helper: index the blocks from the end of the header up to byte `end` by their
+// headers; true if the last one ends exactly there
+static bool walk_blocks(FILE* f, uint64_t end, std::vector<timeline_block_t>* index) {
+    index->clear();
+    uint64_t pos = HEADER_BYTES;
+    while (pos + BLOCK_HEADER_BYTES <= end) {
+        timeline_block_t b;
+        b.offset = pos;
+        bool ok = fseeko(f, pos, SEEK_SET) == 0 && get_u64(f, &b.first_tag) && get_u64(f, &b.rows) &&
+                  get_u64(f, &b.min_cycle) && get_u64(f, &b.max_cycle) && get_u64(f, &b.max_latency);
+        uint64_t bytes = 0;
+        for (int j = 0; ok && j < 5; ++j) {
+            ok = get_u64(f, &b.column_bytes[j]);
+            bytes += b.column_bytes[j];
+        }
+        if (!ok || b.rows == 0 || pos + BLOCK_HEADER_BYTES + bytes > end) return false;
+        index->push_back(b);
+        pos += BLOCK_HEADER_BYTES + bytes;
+    }
+    return pos == end;
+}
+
+void timeline_write_header(timeline_writer_t* w, std::ofstream& f, const uint64_t settings[5])
+{
+    w->rows.clear();
+    w->index.clear();
+    f.write(TIMELINE_MAGIC, 8);
+    put_u64(f, TIMELINE_VERSION);
+    for (int i = 0; i < 5; ++i) put_u64(f, settings[i]);
+    w->offset = HEADER_BYTES;
+}
+
+void timeline_add(timeline_writer_t* w, std::ofstream& f, uint64_t tag, const uint64_t stage[5])
+{
+    if (w->rows.empty()) w->first_tag = tag;
+    w->rows.insert(w->rows.end(), stage, stage + 5);
+    if (w->rows.size() == 5 * TIMELINE_BLOCK_ROWS) timeline_flush(w, f);
+}
+
+void timeline_flush(timeline_writer_t* w, std::ofstream& f)
+{
+    size_t n = w->rows.size() / 5;
+    if (n == 0) return;
+
+    timeline_block_t b;
+    b.offset = w->offset;
+    b.first_tag = w->first_tag;
+    b.rows = n;
+    b.min_cycle = w->rows[0];
+    b.max_cycle = 0;
+    b.max_latency = 0;
+    for (size_t i = 0; i < n; ++i) {
+        const uint64_t* row = &w->rows[5 * i];
+        b.min_cycle = std::min(b.min_cycle, row[0]);
+        b.max_cycle = std::max(b.max_cycle, row[4]);
+        if (row[4] > row[1]) b.max_latency = std::max(b.max_latency, row[4] - row[1]);
+    }
+
+    std::vector<uint8_t> columns[5];
+    uint64_t prev_fetch = b.min_cycle;
+    for (size_t i = 0; i < n; ++i) {
+        const uint64_t* row = &w->rows[5 * i];
+        put_varint(&columns[0], row[0] - prev_fetch);
+        prev_fetch = row[0];
+        for (int j = 1; j < 5; ++j) put_varint(&columns[j], row[j] - row[j - 1]);
+    }
+
+    put_u64(f, b.first_tag);
+    put_u64(f, b.rows);
+    put_u64(f, b.min_cycle);
+    put_u64(f, b.max_cycle);
+    put_u64(f, b.max_latency);
+    uint64_t bytes = 0;
+    for (int j = 0; j < 5; ++j) {
+        b.column_bytes[j] = columns[j].size();
+        bytes += columns[j].size();
+        put_u64(f, b.column_bytes[j]);
+    }
+    for (int j = 0; j < 5; ++j) f.write(reinterpret_cast<const char*>(columns[j].data()), columns[j].size());
+
+    w->index.push_back(b);
+    w->offset += BLOCK_HEADER_BYTES + bytes;
+    w->rows.clear();
+}
+
+void timeline_finish(timeline_writer_t* w, std::ofstream& f, const timeline_stats_t& stats)
+{
+    timeline_flush(w, f);
+    put_u64(f, stats.instructions);
+    put_u64(f, stats.max_disp_size);
+    put_u64(f, stats.cycles);
+    put_u64(f, float_bits(stats.avg_disp_size));
+    put_u64(f, float_bits(stats.avg_inst_fired));
+    put_u64(f, float_bits(stats.avg_inst_retired));
+    uint64_t index_offset = w->offset + STATS_BYTES;
+    for (const timeline_block_t& b : w->index) {
+        put_u64(f, b.offset);
+        put_u64(f, b.first_tag);
+        put_u64(f, b.rows);
+        put_u64(f, b.min_cycle);
+        put_u64(f, b.max_cycle);
+        put_u64(f, b.max_latency);
+        for (int j = 0; j < 5; ++j) put_u64(f, b.column_bytes[j]);
+    }
+    put_u64(f, index_offset);
+    put_u64(f, w->index.size());
+    f.write(TIMELINE_END_MAGIC, 8);
+    w->offset = index_offset + w->index.size() * INDEX_ENTRY_BYTES + FOOTER_BYTES;
+}
+
+bool timeline_resume(timeline_writer_t* w, const char* path, uint64_t offset)
+{
+    FILE* f = fopen(path, "rb");
+    if (f == NULL) return false;
+    bool ok = read_header(f, NULL) && walk_blocks(f, offset, &w->index);
+    fclose(f);
+    w->rows.clear();
+    w->offset = offset;
+    return ok;
+}
+
+bool timeline_open(timeline_reader_t* r, const char* path)
+{
+    r->file = fopen(path, "rb");
+    if (r->file == NULL) return false;
+    r->has_stats = false;
+    r->index.clear();
+    if (!read_header(r->file, r->settings) || fseeko(r->file, 0, SEEK_END) != 0) {
+        timeline_close(r);
+        return false;
+    }
+    uint64_t size = ftello(r->file);
+
+    // The footer, if the run got to write one, locates the statistics and index
+    uint64_t index_offset = 0, blocks = 0;
+    char magic[8];
+    bool trailer = size >= HEADER_BYTES + STATS_BYTES + FOOTER_BYTES &&
+                   fseeko(r->file, size - FOOTER_BYTES, SEEK_SET) == 0 && get_u64(r->file, &index_offset) &&
+                   get_u64(r->file, &blocks) && fread(magic, 8, 1, r->file) == 1 &&
+                   memcmp(magic, TIMELINE_END_MAGIC, 8) == 0 && index_offset >= HEADER_BYTES + STATS_BYTES &&
+                   index_offset + blocks * INDEX_ENTRY_BYTES + FOOTER_BYTES == size;
+    if (!trailer) {
+        // Without one, the blocks are found from their headers; a block cut short is dropped
+        walk_blocks(r->file, size, &r->index);
+        return true;
+    }
+
+    uint64_t s[6];
+    bool ok = fseeko(r->file, index_offset - STATS_BYTES, SEEK_SET) == 0;
+    for (int i = 0; ok && i < 6; ++i) ok = get_u64(r->file, &s[i]);
+    r->index.resize(blocks);
+    for (timeline_block_t& b : r->index) {
+        ok = ok && get_u64(r->file, &b.offset) && get_u64(r->file, &b.first_tag) && get_u64(r->file, &b.rows) &&
+             get_u64(r->file, &b.min_cycle) && get_u64(r->file, &b.max_cycle) && get_u64(r->file, &b.max_latency);
+        for (int j = 0; j < 5; ++j) ok = ok && get_u64(r->file, &b.column_bytes[j]);
+    }
+    if (!ok) {
+        timeline_close(r);
+        return false;
+    }
+    r->has_stats = true;
+    r->stats.instructions = s[0];
+    r->stats.max_disp_size = s[1];
+    r->stats.cycles = s[2];
+    r->stats.avg_disp_size = bits_float(s[3]);
+    r->stats.avg_inst_fired = bits_float(s[4]);
+    r->stats.avg_inst_retired = bits_float(s[5]);
+    return true;
+}
+
+bool timeline_read_block(timeline_reader_t* r, const timeline_block_t& block, std::vector<uint64_t>* stages)
+{
+    uint64_t bytes = 0;
+    for (int j = 0; j < 5; ++j) bytes += block.column_bytes[j];
+    std::vector<uint8_t> buf(bytes);
+    if (fseeko(r->file, block.offset + BLOCK_HEADER_BYTES, SEEK_SET) != 0 ||
+        (bytes > 0 && fread(buf.data(), bytes, 1, r->file) != 1)) {
+        return false;
+    }
+
+    stages->assign(5 * block.rows, 0);
+    const uint8_t* column = buf.data();
+    for (int j = 0; j < 5; ++j) {
+        const uint8_t* p = column;
+        const uint8_t* end = column + block.column_bytes[j];
+        uint64_t prev = block.min_cycle;
+        for (uint64_t i = 0; i < block.rows; ++i) {
+            uint64_t delta;
+            if (!get_varint(&p, end, &delta)) return false;
+            // Fetch continues from the previous row, every later stage from its own row's previous stage
+            uint64_t base = (j == 0) ? prev : (*stages)[5 * i + j - 1];
+            (*stages)[5 * i + j] = prev = base + delta;
+        }
+        column = end;
+    }
+    return true;
+}
+
+void timeline_close(timeline_reader_t* r)
+{
+    if (r->file != NULL) fclose(r->file);
+    r->file = NULL;
+}
@@ -0,0 +1,96 @@
+#ifndef TIMELINE_HPP
+#define TIMELINE_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <vector>
+
+#define TIMELINE_MAGIC "PSTLINE1"
+#define TIMELINE_END_MAGIC "PSTLEND1"
+#define TIMELINE_VERSION 1
+#define TIMELINE_BLOCK_ROWS 4096
+
+// Binary timeline: the rows of the text output (INST FETCH DISP SCHED EXEC STATE)
+// stored by column and delta-encoded. All fixed-size fields are uint64.
+//
+//  header:  magic, version, R, k0, k1, k2, F
+//  blocks:  consecutive tags, up to TIMELINE_BLOCK_ROWS of them: a block header
+//           (the fields of timeline_block_t after offset), then five columns of
+//           zigzag varints: the fetch cycle minus the previous row's (minus
+//           min_cycle for the first row), then each later stage minus the one
+//           before it. Every block decodes on its own.
+//  trailer: statistics, the block index (every field of timeline_block_t per
+//           block), then a footer giving the index offset, the block count and
+//           TIMELINE_END_MAGIC.
+//
+// Cycles are stored as the simulator counts them; the text format prints them +1.
+// A file cut off at a checkpoint has no trailer yet; its blocks are then found by
+// walking the block headers.
+
+typedef struct _timeline_block_t
+{
+    uint64_t offset;          // File offset of the block header
+    uint64_t first_tag;
+    uint64_t rows;
+    uint64_t min_cycle;       // Earliest fetch cycle in the block
+    uint64_t max_cycle;       // Latest retire cycle in the block
+    uint64_t max_latency;     // Longest dispatch-to-retire time in the block
+    uint64_t column_bytes[5];
+} timeline_block_t;
+
+// Run statistics of the trailer, as the text format prints them
+typedef struct _timeline_stats_t
+{
+    uint64_t instructions;
+    uint64_t max_disp_size;
+    uint64_t cycles;
+    float avg_disp_size;
+    float avg_inst_fired;
+    float avg_inst_retired;
+} timeline_stats_t;
+
+// Writer state: the rows of the block being built and the index of those written
+typedef struct _timeline_writer_t
+{
+    uint64_t offset;                      // Bytes written to the file so far
+    uint64_t first_tag;                   // Tag of the first buffered row
+    std::vector<uint64_t> rows;           // Five stage cycles per buffered row
+    std::vector<timeline_block_t> index;
+} timeline_writer_t;
+
+// Start a new file with the header for the given R, k0, k1, k2, F
+void timeline_write_header(timeline_writer_t* w, std::ofstream& f, const uint64_t settings[5]);
+
+// Append the row of `tag`, one above the previous row's; a full block is written out
+void timeline_add(timeline_writer_t* w, std::ofstream& f, uint64_t tag, const uint64_t stage[5]);
+
+// Write the buffered rows as a (possibly short) block
+void timeline_flush(timeline_writer_t* w, std::ofstream& f);
+
+// Write the last block and the trailer
+void timeline_finish(timeline_writer_t* w, std::ofstream& f, const timeline_stats_t& stats);
+
+// Continue the file at path from byte `offset`, which must end a block: the
+// index is rebuilt from the block headers before it. False if the file is not
+// a timeline or offset is not a block boundary.
+bool timeline_resume(timeline_writer_t* w, const char* path, uint64_t offset);
+
+typedef struct _timeline_reader_t
+{
+    FILE* file;
+    uint64_t settings[5];
+    bool has_stats;           // False for a file without a trailer
+    timeline_stats_t stats;
+    std::vector<timeline_block_t> index;
+} timeline_reader_t;
+
+// Open a binary timeline and load its header and block index
+bool timeline_open(timeline_reader_t* r, const char* path);
+
+// Decode one block into five stage cycles per row
+bool timeline_read_block(timeline_reader_t* r, const timeline_block_t& block, std::vector<uint64_t>* stages);
+
+void timeline_close(timeline_reader_t* r);
+
+#endif /* TIMELINE_HPP */
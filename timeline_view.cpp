@@ -0,0 +1,247 @@
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include <vector>
+#include "timeline.hpp"
+
+// Reads binary timelines written by procsim --output FILE.bin. Without a query
+// the whole timeline is converted to procsim's text output; a query prints only
+// the matching rows. Queries go through the block index, so only the blocks that
+// can hold a match are read. Tags and cycles are numbered as in the text output.
+
+// One row of a query result
+typedef struct _view_row_t
+{
+    uint64_t tag;
+    uint64_t stage[5];
+} view_row_t;
+
+void print_help_and_exit(void) {
+    printf("timeline_view [OPTIONS]\n");
+    printf("  -i file\tBinary timeline (required)\n");
+    printf("  -o file\tOutput (default stdout)\n");
+    printf("  -n N:M\t\tRows of tags N to M\n");
+    printf("  -c X:Y\t\tRows of the instructions in flight during cycles X to Y\n");
+    printf("  -s N\t\tThe N rows with the longest dispatch-to-retire latency, longest first\n");
+    printf("  -h\t\tThis helpful output\n");
+    printf("Without -n, -c or -s the whole timeline is written in the text format.\n");
+    exit(0);
+}
+
+//
+// parse_range
+//
+//  parses "A:B" with A <= B
+//
+static bool parse_range(const char* arg, uint64_t* lo, uint64_t* hi)
+{
+    char* end;
+    *lo = strtoull(arg, &end, 10);
+    if (end == arg || *end != ':') return false;
+    const char* p = end + 1;
+    *hi = strtoull(p, &end, 10);
+    return end != p && *end == '\0' && *lo <= *hi;
+}
+
+//
+// print_row
+//
+//  writes a row as the text output does, optionally followed by its latency
+//
+static void print_row(FILE* out, uint64_t tag, const uint64_t stage[5], bool latency)
+{
+    fprintf(out, "%" PRIu64, tag);
+    for (int j = 0; j < 5; ++j) fprintf(out, "\t%" PRIu64, stage[j] + 1);
+    if (latency) fprintf(out, "\t%" PRIu64, stage[4] - stage[1]);
+    fprintf(out, "\n");
+}
+
+//
+// convert
+//
+//  writes the whole timeline in procsim's text format; the statistics only if
+//  the run completed
+//
+static bool convert(timeline_reader_t* r, FILE* out)
+{
+    static const char* const NAMES[5] = { "R", "k0", "k1", "k2", "F" };
+    fprintf(out, "Processor Settings\n");
+    for (int i = 0; i < 5; ++i) fprintf(out, "%s: %" PRIu64 "\n", NAMES[i], r->settings[i]);
+    fprintf(out, "\n");
+    fprintf(out, "INST\tFETCH\tDISP\tSCHED\tEXEC\tSTATE\n");
+
+    std::vector<uint64_t> stages;
+    for (const timeline_block_t& b : r->index) {
+        if (!timeline_read_block(r, b, &stages)) return false;
+        for (uint64_t i = 0; i < b.rows; ++i) print_row(out, b.first_tag + i, &stages[5 * i], false);
+    }
+
+    if (r->has_stats) {
+        fprintf(out, "\nProcessor stats:\n");
+        fprintf(out, "Total instructions: %" PRIu64 "\n", r->stats.instructions);
+        fprintf(out, "Avg Dispatch queue size: %f\n", r->stats.avg_disp_size);
+        fprintf(out, "Maximum Dispatch queue size: %" PRIu64 "\n", r->stats.max_disp_size);
+        fprintf(out, "Avg inst fired per cycle: %f\n", r->stats.avg_inst_fired);
+        fprintf(out, "Avg inst retired per cycle: %f\n", r->stats.avg_inst_retired);
+        fprintf(out, "Total run time (cycles): %" PRIu64 "\n", r->stats.cycles);
+    }
+    return true;
+}
+
+//
+// query_tags
+//
+//  writes the rows of tags lo to hi, reading only the blocks that hold them
+//
+static bool query_tags(timeline_reader_t* r, uint64_t lo, uint64_t hi, FILE* out)
+{
+    // The first block that can hold lo is the last one starting at or before it
+    std::vector<timeline_block_t>::const_iterator it =
+        std::upper_bound(r->index.begin(), r->index.end(), lo,
+                         [](uint64_t tag, const timeline_block_t& b) { return tag < b.first_tag; });
+    if (it != r->index.begin()) --it;
+
+    std::vector<uint64_t> stages;
+    for (; it != r->index.end() && it->first_tag <= hi; ++it) {
+        if (it->first_tag + it->rows <= lo) continue;
+        if (!timeline_read_block(r, *it, &stages)) return false;
+        for (uint64_t i = 0; i < it->rows; ++i) {
+            uint64_t tag = it->first_tag + i;
+            if (tag >= lo && tag <= hi) print_row(out, tag, &stages[5 * i], false);
+        }
+    }
+    return true;
+}
+
+//
+// query_cycles
+//
+//  writes the rows of the instructions fetched by cycle hi and retired at or
+//  after cycle lo (simulator numbering), skipping blocks wholly outside
+//
+static bool query_cycles(timeline_reader_t* r, uint64_t lo, uint64_t hi, FILE* out)
+{
+    std::vector<uint64_t> stages;
+    for (const timeline_block_t& b : r->index) {
+        if (b.min_cycle > hi || b.max_cycle < lo) continue;
+        if (!timeline_read_block(r, b, &stages)) return false;
+        for (uint64_t i = 0; i < b.rows; ++i) {
+            const uint64_t* stage = &stages[5 * i];
+            if (stage[0] <= hi && stage[4] >= lo) print_row(out, b.first_tag + i, stage, false);
+        }
+    }
+    return true;
+}
+
+// Helper: order rows by latency, longest first, then by tag
+static bool slower(const view_row_t& a, const view_row_t& b) {
+    uint64_t la = a.stage[4] - a.stage[1];
+    uint64_t lb = b.stage[4] - b.stage[1];
+    return la != lb ? la > lb : a.tag < b.tag;
+}
+
+//
+// query_slowest
+//
+//  writes the n rows with the longest dispatch-to-retire latency. The best n so
+//  far are kept in a heap; a block whose longest latency cannot displace the
+//  shortest of them is not read.
+//
+static bool query_slowest(timeline_reader_t* r, uint64_t n, FILE* out)
+{
+    std::vector<view_row_t> heap;   // Top is the shortest of the best n
+    std::vector<uint64_t> stages;
+    for (const timeline_block_t& b : r->index) {
+        if (n == 0) break;
+        if (heap.size() == n && b.max_latency <= heap.front().stage[4] - heap.front().stage[1]) continue;
+        if (!timeline_read_block(r, b, &stages)) return false;
+        for (uint64_t i = 0; i < b.rows; ++i) {
+            view_row_t row;
+            row.tag = b.first_tag + i;
+            memcpy(row.stage, &stages[5 * i], sizeof(row.stage));
+            if (row.stage[4] < row.stage[1]) continue;
+            if (heap.size() < n) {
+                heap.push_back(row);
+                std::push_heap(heap.begin(), heap.end(), slower);
+            } else if (slower(row, heap.front())) {
+                std::pop_heap(heap.begin(), heap.end(), slower);
+                heap.back() = row;
+                std::push_heap(heap.begin(), heap.end(), slower);
+            }
+        }
+    }
+    std::sort_heap(heap.begin(), heap.end(), slower);
+    for (const view_row_t& row : heap) print_row(out, row.tag, row.stage, true);
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    int opt;
+    const char* in_path = NULL;
+    const char* out_path = NULL;
+    char query = 0;
+    uint64_t lo = 0, hi = 0;
+
+    while(-1 != (opt = getopt(argc, argv, "i:o:n:c:s:h"))) {
+        switch(opt) {
+        case 'i':
+            in_path = optarg;
+            break;
+        case 'o':
+            out_path = optarg;
+            break;
+        case 'n':
+        case 'c':
+            if (!parse_range(optarg, &lo, &hi)) print_help_and_exit();
+            query = static_cast<char>(opt);
+            break;
+        case 's':
+            lo = strtoull(optarg, NULL, 10);
+            query = 's';
+            break;
+        case 'h':
+            /* Fall through */
+        default:
+            print_help_and_exit();
+            break;
+        }
+    }
+    if (in_path == NULL) print_help_and_exit();
+
+    timeline_reader_t reader;
+    if (!timeline_open(&reader, in_path)) {
+        fprintf(stderr, "%s is not a binary timeline\n", in_path);
+        return 1;
+    }
+    FILE* out = stdout;
+    if (out_path != NULL && (out = fopen(out_path, "w")) == NULL) {
+        fprintf(stderr, "Failed to open %s for writing\n", out_path);
+        timeline_close(&reader);
+        return 1;
+    }
+
+    bool ok;
+    if (query == 0) {
+        ok = convert(&reader, out);
+    } else {
+        fprintf(out, "INST\tFETCH\tDISP\tSCHED\tEXEC\tSTATE%s\n", (query == 's') ? "\tLATENCY" : "");
+        if (query == 'n') {
+            ok = query_tags(&reader, lo, hi, out);
+        } else if (query == 'c') {
+            // Cycles are given as the text output prints them, one above the simulator's count
+            ok = (hi == 0) || query_cycles(&reader, (lo > 0) ? lo - 1 : 0, hi - 1, out);
+        } else {
+            ok = query_slowest(&reader, lo, out);
+        }
+    }
+    timeline_close(&reader);
+    ok = (out == stdout || fclose(out) == 0) && ok;
+    if (!ok) {
+        fprintf(stderr, "Timeline %s is corrupt\n", in_path);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,471 @@
+#include <algorithm>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+#ifdef PROCSIM_XZ
+#include <lzma.h>
+#endif
+#ifdef PROCSIM_ZSTD
+#include <zstd.h>
+#endif
+#include "trace.hpp"
+
+static_assert(sizeof(trace_header_t) == 24, "trace_header_t must be packed");
+static_assert(sizeof(trace_record_t) == 8, "trace_record_t must be packed");
+
+// Decompressor of a compressed trace. Compressed bytes come straight from the
+// file mapping if there is one, else from block reads into `in`.
+typedef struct _trace_codec_t
+{
+    const unsigned char* map;     // Mapped file, NULL if read through `in`
+    size_t map_len;
+    const unsigned char* next_in; // Compressed bytes not yet consumed
+    size_t avail_in;
+    bool at_end;                  // The last stream or frame has ended
+    bool failed;
+    z_stream gz;
+#ifdef PROCSIM_XZ
+    lzma_stream xz;
+#endif
+#ifdef PROCSIM_ZSTD
+    ZSTD_DStream* zstd;
+#endif
+    unsigned char in[TRACE_BUF_SIZE];
+} trace_codec_t;
+
+// Helper: compression format of a file starting with the n bytes at p
+static trace_compression_t detect_compression(const char* p, size_t n) {
+    static const unsigned char gzip[] = { 0x1f, 0x8b };
+    static const unsigned char xz[] = { 0xfd, '7', 'z', 'X', 'Z', 0x00 };
+    static const unsigned char zstd[] = { 0x28, 0xb5, 0x2f, 0xfd };
+    if (n >= sizeof(gzip) && memcmp(p, gzip, sizeof(gzip)) == 0) return TRACE_COMPRESSION_GZIP;
+    if (n >= sizeof(xz) && memcmp(p, xz, sizeof(xz)) == 0) return TRACE_COMPRESSION_XZ;
+    if (n >= sizeof(zstd) && memcmp(p, zstd, sizeof(zstd)) == 0) return TRACE_COMPRESSION_ZSTD;
+    return TRACE_COMPRESSION_NONE;
+}
+
+// Helper: set up the decompressor for kind; false if this build cannot decode it
+static bool codec_init(trace_codec_t* codec, trace_compression_t kind) {
+    switch (kind) {
+    case TRACE_COMPRESSION_GZIP:
+        memset(&codec->gz, 0, sizeof(codec->gz));
+        // 15 + 32: the largest window, with gzip or zlib headers detected automatically
+        return inflateInit2(&codec->gz, 15 + 32) == Z_OK;
+#ifdef PROCSIM_XZ
+    case TRACE_COMPRESSION_XZ:
+        codec->xz = LZMA_STREAM_INIT;
+        return lzma_stream_decoder(&codec->xz, UINT64_MAX, 0) == LZMA_OK;
+#endif
+#ifdef PROCSIM_ZSTD
+    case TRACE_COMPRESSION_ZSTD:
+        codec->zstd = ZSTD_createDStream();
+        return codec->zstd != NULL && !ZSTD_isError(ZSTD_initDStream(codec->zstd));
+#endif
+    default:
+        return false;
+    }
+}
+
+static void codec_end(trace_codec_t* codec, trace_compression_t kind) {
+    switch (kind) {
+    case TRACE_COMPRESSION_GZIP:
+        inflateEnd(&codec->gz);
+        break;
+#ifdef PROCSIM_XZ
+    case TRACE_COMPRESSION_XZ:
+        lzma_end(&codec->xz);
+        break;
+#endif
+#ifdef PROCSIM_ZSTD
+    case TRACE_COMPRESSION_ZSTD:
+        ZSTD_freeDStream(codec->zstd);
+        break;
+#endif
+    default:
+        break;
+    }
+}
+
+// Helper: decompress pending input into out; returns the bytes written. A stream
+// that ends is followed by the next one, as for concatenated .gz or .xz files.
+static size_t codec_step(trace_codec_t* codec, trace_compression_t kind, unsigned char* out, size_t max) {
+    size_t in_chunk = codec->avail_in;
+    size_t in_left = in_chunk;
+    size_t out_left = max;
+    codec->at_end = false;
+    switch (kind) {
+    case TRACE_COMPRESSION_GZIP: {
+        // zlib counts in 32 bits
+        in_chunk = std::min<size_t>(in_chunk, 1u << 30);
+        codec->gz.next_in = const_cast<unsigned char*>(codec->next_in);
+        codec->gz.avail_in = static_cast<uInt>(in_chunk);
+        codec->gz.next_out = out;
+        codec->gz.avail_out = static_cast<uInt>(std::min<size_t>(max, 1u << 30));
+        out_left = max - codec->gz.avail_out;
+        int ret = inflate(&codec->gz, Z_NO_FLUSH);
+        in_left = codec->gz.avail_in;
+        out_left += codec->gz.avail_out;
+        if (ret == Z_STREAM_END) {
+            codec->at_end = true;
+            inflateReset(&codec->gz);
+        } else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+            codec->failed = true;
+        }
+        break;
+    }
+#ifdef PROCSIM_XZ
+    case TRACE_COMPRESSION_XZ: {
+        codec->xz.next_in = codec->next_in;
+        codec->xz.avail_in = in_chunk;
+        codec->xz.next_out = out;
+        codec->xz.avail_out = max;
+        lzma_ret ret = lzma_code(&codec->xz, LZMA_RUN);
+        in_left = codec->xz.avail_in;
+        out_left = codec->xz.avail_out;
+        if (ret == LZMA_STREAM_END) {
+            codec->at_end = true;
+            lzma_end(&codec->xz);
+            codec_init(codec, kind);
+        } else if (ret != LZMA_OK && ret != LZMA_BUF_ERROR) {
+            codec->failed = true;
+        }
+        break;
+    }
+#endif
+#ifdef PROCSIM_ZSTD
+    case TRACE_COMPRESSION_ZSTD: {
+        ZSTD_inBuffer input = { codec->next_in, in_chunk, 0 };
+        ZSTD_outBuffer output = { out, max, 0 };
+        size_t ret = ZSTD_decompressStream(codec->zstd, &output, &input);
+        in_left = in_chunk - input.pos;
+        out_left = max - output.pos;
+        if (ZSTD_isError(ret)) codec->failed = true;
+        else if (ret == 0) codec->at_end = true;
+        break;
+    }
+#endif
+    default:
+        codec->failed = true;
+        break;
+    }
+    if (codec->failed) fprintf(stderr, "Compressed trace is corrupt\n");
+    codec->next_in += in_chunk - in_left;
+    codec->avail_in -= in_chunk - in_left;
+    return max - out_left;
+}
+
+// Helper: decompress up to max bytes into out; returns 0 at the end of the input
+static size_t codec_read(trace_reader_t* reader, char* out, size_t max) {
+    trace_codec_t* codec = reader->codec;
+    size_t total = 0;
+    while (total < max && !codec->failed) {
+        if (codec->avail_in == 0 && codec->map == NULL) {
+            codec->next_in = codec->in;
+            codec->avail_in = fread(codec->in, 1, sizeof(codec->in), reader->file);
+        }
+        if (codec->avail_in == 0) {
+            if (!codec->at_end) {
+                fprintf(stderr, "Compressed trace is truncated\n");
+                codec->failed = true;
+            }
+            break;
+        }
+        total += codec_step(codec, reader->compression, reinterpret_cast<unsigned char*>(out) + total, max - total);
+    }
+    return total;
+}
+
+// Helper: keep unread bytes, then top the buffer up from the file.
+// Returns false if no new bytes could be read (always, for a mapped file).
+static bool refill(trace_reader_t* reader) {
+    if (reader->mapped) return false;
+    size_t left = reader->len - reader->pos;
+    if (left > 0 && reader->pos > 0) {
+        memmove(reader->buf, reader->buf + reader->pos, left);
+    }
+    reader->data = reader->buf;
+    reader->pos = 0;
+    reader->len = left;
+    size_t got = reader->codec ? codec_read(reader, reader->buf + left, TRACE_BUF_SIZE - left)
+                               : fread(reader->buf + left, 1, TRACE_BUF_SIZE - left, reader->file);
+    reader->len += got;
+    return got > 0;
+}
+
+// Helper: next character without consuming it, or EOF
+static inline int peek_char(trace_reader_t* reader) {
+    if (reader->pos == reader->len && !refill(reader)) return EOF;
+    return static_cast<unsigned char>(reader->data[reader->pos]);
+}
+
+static inline void skip_space(trace_reader_t* reader) {
+    int c;
+    while ((c = peek_char(reader)) == ' ' || c == '\t' || c == '\n' || c == '\r') {
+        reader->pos++;
+    }
+}
+
+static inline int hex_digit(int c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Helper: parse a hex number the way "%x" does (optional 0x prefix)
+static bool parse_hex(trace_reader_t* reader, uint32_t* val) {
+    skip_space(reader);
+    *val = 0;
+    bool any = false;
+    if (peek_char(reader) == '0') {
+        reader->pos++;
+        any = true;
+        int c = peek_char(reader);
+        if (c == 'x' || c == 'X') {
+            reader->pos++;
+            any = false;
+        }
+    }
+    int d;
+    while ((d = hex_digit(peek_char(reader))) >= 0) {
+        *val = (*val << 4) | static_cast<uint32_t>(d);
+        reader->pos++;
+        any = true;
+    }
+    return any;
+}
+
+// Helper: parse a signed decimal number the way "%d" does
+static bool parse_int(trace_reader_t* reader, int32_t* val) {
+    skip_space(reader);
+    bool neg = false;
+    int c = peek_char(reader);
+    if (c == '-' || c == '+') {
+        neg = (c == '-');
+        reader->pos++;
+        c = peek_char(reader);
+    }
+    if (c < '0' || c > '9') return false;
+    int64_t v = 0;
+    while ((c = peek_char(reader)) >= '0' && c <= '9') {
+        v = v * 10 + (c - '0');
+        reader->pos++;
+    }
+    *val = static_cast<int32_t>(neg ? -v : v);
+    return true;
+}
+
+static bool next_text(trace_reader_t* reader, trace_inst_t* inst) {
+    if (!parse_hex(reader, &inst->instruction_address)) return false;
+    if (!parse_int(reader, &inst->op_code)) return false;
+    if (!parse_int(reader, &inst->dest_reg)) return false;
+    if (!parse_int(reader, &inst->src_reg[0])) return false;
+    if (!parse_int(reader, &inst->src_reg[1])) return false;
+    // Optional data address on the same line
+    int c;
+    while ((c = peek_char(reader)) == ' ' || c == '\t') {
+        reader->pos++;
+    }
+    inst->data_address = 0;
+    if (hex_digit(c) >= 0 && !parse_hex(reader, &inst->data_address)) return false;
+    skip_space(reader);
+    return true;
+}
+
+static bool next_binary(trace_reader_t* reader, trace_inst_t* inst) {
+    size_t size = sizeof(trace_record_t) + ((reader->flags & TRACE_FLAG_DATA_ADDR) ? sizeof(uint32_t) : 0);
+    if (reader->len - reader->pos < size) {
+        refill(reader);
+        if (reader->len - reader->pos < size) return false;
+    }
+    trace_record_t rec;
+    memcpy(&rec, reader->data + reader->pos, sizeof(rec));
+    inst->data_address = 0;
+    if (reader->flags & TRACE_FLAG_DATA_ADDR) {
+        memcpy(&inst->data_address, reader->data + reader->pos + sizeof(rec), sizeof(uint32_t));
+    }
+    reader->pos += size;
+    uint32_t address = rec.address;
+    if (reader->flags & TRACE_FLAG_DELTA_PC) {
+        address += reader->prev_address;
+    }
+    reader->prev_address = address;
+    inst->instruction_address = address;
+    inst->op_code = rec.op_code;
+    inst->dest_reg = rec.dest_reg;
+    inst->src_reg[0] = rec.src_reg[0];
+    inst->src_reg[1] = rec.src_reg[1];
+    return true;
+}
+
+bool trace_open(trace_reader_t* reader, FILE* file)
+{
+    reader->file = file;
+    reader->format = TRACE_FORMAT_TEXT;
+    reader->flags = 0;
+    reader->prev_address = 0;
+    reader->data = reader->buf;
+    reader->pos = 0;
+    reader->len = 0;
+    reader->mapped = false;
+    reader->released = 0;
+    reader->compression = TRACE_COMPRESSION_NONE;
+    reader->codec = NULL;
+
+    // Map regular files and parse them in place, starting at the current offset
+    struct stat st;
+    long offset = ftell(file);
+    if (fstat(fileno(file), &st) == 0 && S_ISREG(st.st_mode) && offset >= 0 && st.st_size > offset) {
+        void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+        if (map != MAP_FAILED) {
+            madvise(map, st.st_size, MADV_SEQUENTIAL);
+            reader->data = static_cast<const char*>(map);
+            reader->pos = offset;
+            reader->len = st.st_size;
+            reader->mapped = true;
+        }
+    }
+
+    // A compressed input is decoded from its first byte on; the mapping (or the
+    // bytes read so far) becomes the codec's input
+    while (reader->len - reader->pos < 6 && refill(reader)) {
+    }
+    trace_compression_t compression = detect_compression(reader->data + reader->pos, reader->len - reader->pos);
+    if (compression != TRACE_COMPRESSION_NONE) {
+        trace_codec_t* codec = new trace_codec_t();
+        if (!codec_init(codec, compression)) {
+            static const char* const names[] = { "", "gzip", "xz", "zstd" };
+            fprintf(stderr, "Trace is %s-compressed, which this build cannot read\n", names[compression]);
+            delete codec;
+            return false;
+        }
+        if (reader->mapped) {
+            codec->map = reinterpret_cast<const unsigned char*>(reader->data);
+            codec->map_len = reader->len;
+            codec->next_in = codec->map + reader->pos;
+        } else {
+            memcpy(codec->in, reader->data + reader->pos, reader->len - reader->pos);
+            codec->next_in = codec->in;
+        }
+        codec->avail_in = reader->len - reader->pos;
+        reader->compression = compression;
+        reader->codec = codec;
+        reader->data = reader->buf;
+        reader->pos = 0;
+        reader->len = 0;
+        reader->mapped = false;
+    }
+
+    // Detect the format from the first bytes; they stay buffered for the text parser
+    while (reader->len - reader->pos < sizeof(trace_header_t) && refill(reader)) {
+    }
+    const char* start = reader->data + reader->pos;
+    size_t avail = reader->len - reader->pos;
+    if (avail < TRACE_MAGIC_LEN || memcmp(start, TRACE_MAGIC, TRACE_MAGIC_LEN) != 0) {
+        return true;
+    }
+
+    trace_header_t header;
+    if (avail < sizeof(header)) {
+        fprintf(stderr, "Binary trace header is truncated\n");
+        return false;
+    }
+    memcpy(&header, start, sizeof(header));
+    if (header.version != TRACE_VERSION) {
+        fprintf(stderr, "Unsupported binary trace version %u\n", header.version);
+        return false;
+    }
+    reader->format = TRACE_FORMAT_BINARY;
+    reader->flags = header.flags;
+    reader->pos += sizeof(header);
+    return true;
+}
+
+void trace_close(trace_reader_t* reader)
+{
+    if (reader->codec != NULL) {
+        codec_end(reader->codec, reader->compression);
+        if (reader->codec->map != NULL) munmap(const_cast<unsigned char*>(reader->codec->map), reader->codec->map_len);
+        delete reader->codec;
+        reader->codec = NULL;
+    }
+    if (reader->mapped) {
+        munmap(const_cast<char*>(reader->data), reader->len);
+        reader->data = reader->buf;
+        reader->pos = 0;
+        reader->len = 0;
+        reader->mapped = false;
+    }
+}
+
+bool trace_mapped_bytes(const trace_reader_t* reader, const char** data, size_t* len)
+{
+    if (reader->codec != NULL && reader->codec->map != NULL) {
+        *data = reinterpret_cast<const char*>(reader->codec->map);
+        *len = reader->codec->map_len;
+        return true;
+    }
+    if (!reader->mapped) return false;
+    *data = reader->data;
+    *len = reader->len;
+    return true;
+}
+
+bool trace_next(trace_reader_t* reader, trace_inst_t* inst)
+{
+    if (reader->format == TRACE_FORMAT_BINARY) {
+        return next_binary(reader, inst);
+    }
+    return next_text(reader, inst);
+}
+
+size_t trace_next_batch(trace_reader_t* reader, trace_inst_t* out, size_t max)
+{
+    size_t n = 0;
+    if (reader->format == TRACE_FORMAT_BINARY) {
+        while (n < max && next_binary(reader, &out[n])) ++n;
+    } else {
+        while (n < max && next_text(reader, &out[n])) ++n;
+    }
+
+    // Drop the pages behind the read position once enough have been consumed
+    if (reader->mapped && reader->pos - reader->released >= TRACE_RELEASE_SIZE) {
+        size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        size_t bytes = (reader->pos - reader->released) / page * page;
+        madvise(const_cast<char*>(reader->data) + reader->released, bytes, MADV_DONTNEED);
+        reader->released += bytes;
+    }
+    return n;
+}
+
+bool trace_encode(const trace_inst_t* inst, uint32_t flags, uint32_t* prev_address, trace_record_t* rec)
+{
+    auto fits = [](int32_t v) { return v >= INT8_MIN && v <= INT8_MAX; };
+    if (!fits(inst->op_code) || !fits(inst->dest_reg) ||
+        !fits(inst->src_reg[0]) || !fits(inst->src_reg[1])) {
+        return false;
+    }
+    rec->address = inst->instruction_address;
+    if (flags & TRACE_FLAG_DELTA_PC) {
+        rec->address -= *prev_address;
+    }
+    *prev_address = inst->instruction_address;
+    rec->op_code = static_cast<int8_t>(inst->op_code);
+    rec->dest_reg = static_cast<int8_t>(inst->dest_reg);
+    rec->src_reg[0] = static_cast<int8_t>(inst->src_reg[0]);
+    rec->src_reg[1] = static_cast<int8_t>(inst->src_reg[1]);
+    return true;
+}
+
+bool trace_write_header(FILE* file, uint32_t flags, uint64_t count)
+{
+    trace_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TRACE_MAGIC, TRACE_MAGIC_LEN);
+    header.version = TRACE_VERSION;
+    header.flags = flags;
+    header.count = count;
+    return fwrite(&header, sizeof(header), 1, file) == 1;
+}
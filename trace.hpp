@@ -0,0 +1,118 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+// Either format may be compressed: gzip always, xz and zstd in builds with
+// PROCSIM_XZ / PROCSIM_ZSTD. Compression is detected from the magic bytes and
+// undone while reading, so compressed traces are never expanded on disk.
+//
+// Binary trace format (all fields little-endian):
+//   header:  trace_header_t (24 bytes), magic "PSTRACE1"
+//   records: trace_record_t (8 bytes) per instruction, until end of file
+// With TRACE_FLAG_DELTA_PC set, a record's address is the difference (mod 2^32)
+// from the previous instruction's address, which compresses much better.
+// With TRACE_FLAG_DATA_ADDR set, every record is followed by a uint32 data address.
+#define TRACE_MAGIC "PSTRACE1"
+#define TRACE_MAGIC_LEN 8
+#define TRACE_VERSION 1
+#define TRACE_FLAG_DELTA_PC 0x1
+#define TRACE_FLAG_DATA_ADDR 0x2
+
+// Size of the reader's refill buffer (used when the input cannot be mapped)
+#define TRACE_BUF_SIZE (1 << 16)
+
+// Consumed parts of a mapped trace are dropped from memory in steps of this size,
+// so traces larger than RAM stream through without pushing out other pages
+#define TRACE_RELEASE_SIZE (64 << 20)
+
+// Number of instructions decoded per batch into the fetch ring
+#define TRACE_BATCH_SIZE 4096
+
+typedef struct _trace_header_t
+{
+    char magic[TRACE_MAGIC_LEN];
+    uint32_t version;
+    uint32_t flags;
+    uint64_t count;           // Number of records (0 if unknown)
+} trace_header_t;
+
+typedef struct _trace_record_t
+{
+    uint32_t address;         // instruction_address, or delta if TRACE_FLAG_DELTA_PC
+    int8_t op_code;
+    int8_t dest_reg;
+    int8_t src_reg[2];
+} trace_record_t;
+
+// One decoded trace instruction
+typedef struct _trace_inst_t
+{
+    uint32_t instruction_address;
+    int32_t op_code;
+    int32_t dest_reg;
+    int32_t src_reg[2];
+    uint32_t data_address;    // Memory operand address, 0 if the instruction has none
+} trace_inst_t;
+
+enum trace_format_t
+{
+    TRACE_FORMAT_TEXT,        // "%x %d %d %d %d" per line, optionally followed by " %x" (data address)
+    TRACE_FORMAT_BINARY
+};
+
+enum trace_compression_t
+{
+    TRACE_COMPRESSION_NONE,
+    TRACE_COMPRESSION_GZIP,
+    TRACE_COMPRESSION_XZ,
+    TRACE_COMPRESSION_ZSTD
+};
+
+struct _trace_codec_t;
+
+// Trace reader. Regular files are mmap'ed and parsed in place; pipes and
+// terminals fall back to block reads into buf. The format is detected from
+// the first bytes. A compressed input is decompressed into buf by the codec,
+// from the file mapping if there is one.
+typedef struct _trace_reader_t
+{
+    FILE* file;
+    trace_format_t format;
+    uint32_t flags;
+    uint32_t prev_address;
+    const char* data;         // Bytes being parsed: the file mapping, or buf
+    size_t pos;
+    size_t len;
+    bool mapped;
+    size_t released;          // Mapped bytes already handed back with MADV_DONTNEED
+    trace_compression_t compression;
+    struct _trace_codec_t* codec;   // Decompressor state, NULL for uncompressed input
+    char buf[TRACE_BUF_SIZE];
+} trace_reader_t;
+
+// Attach a reader to file and detect its format; false if the binary header is invalid
+bool trace_open(trace_reader_t* reader, FILE* file);
+
+// Unmap the trace and release the decompressor (the FILE* stays open)
+void trace_close(trace_reader_t* reader);
+
+// The whole input file as mapped (still compressed, if it is); false if not mapped
+bool trace_mapped_bytes(const trace_reader_t* reader, const char** data, size_t* len);
+
+// Read the next instruction; false at end of trace or on a malformed record
+bool trace_next(trace_reader_t* reader, trace_inst_t* inst);
+
+// Decode up to max instructions into out; returns the number decoded (0 at end of trace)
+size_t trace_next_batch(trace_reader_t* reader, trace_inst_t* out, size_t max);
+
+// Pack an instruction into a binary record; false if a field does not fit. With
+// TRACE_FLAG_DATA_ADDR the data address is written separately, after the record.
+bool trace_encode(const trace_inst_t* inst, uint32_t flags, uint32_t* prev_address, trace_record_t* rec);
+
+// Write a binary trace header
+bool trace_write_header(FILE* file, uint32_t flags, uint64_t count);
+
+#endif /* TRACE_HPP */
@@ -0,0 +1,112 @@
+#include <cinttypes>
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "trace_cache.hpp"
+
+static_assert(sizeof(trace_cache_header_t) == 64, "trace_cache_header_t must be 64 bytes");
+
+// Helper: path of the cache entry for hash
+static std::string cache_path(const char* dir, uint64_t hash) {
+    char name[32];
+    snprintf(name, sizeof(name), "%016" PRIx64, hash);
+    return std::string(dir) + "/" + name + TRACE_CACHE_SUFFIX;
+}
+
+// Helper: 64-bit hash over a byte range, one word at a time
+static uint64_t hash_bytes(const char* p, size_t n) {
+    const uint64_t k = 0xff51afd7ed558ccdULL;
+    uint64_t h = 0x9e3779b97f4a7c15ULL ^ n;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint64_t w;
+        memcpy(&w, p + i, 8);
+        h = (h ^ w) * k;
+        h ^= h >> 29;
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, p + i, n - i);
+    h = (h ^ tail) * k;
+    h ^= h >> 32;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 29;
+    return h;
+}
+
+bool trace_content_hash(const trace_reader_t* reader, uint64_t* hash)
+{
+    const char* data;
+    size_t len;
+    if (!trace_mapped_bytes(reader, &data, &len)) return false;
+    *hash = hash_bytes(data, len);
+    return true;
+}
+
+bool trace_cache_attach(const char* dir, uint64_t hash, trace_cache_t* cache)
+{
+    memset(cache, 0, sizeof(*cache));
+    std::string path = cache_path(dir, hash);
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(trace_cache_header_t)) {
+        close(fd);
+        return false;
+    }
+    void* map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return false;
+
+    const trace_cache_header_t* header = static_cast<const trace_cache_header_t*>(map);
+    bool valid = memcmp(header->magic, TRACE_CACHE_MAGIC, TRACE_MAGIC_LEN) == 0 &&
+                 header->version == TRACE_CACHE_VERSION &&
+                 header->inst_size == sizeof(trace_inst_t) &&
+                 header->content_hash == hash &&
+                 sizeof(*header) + header->count * sizeof(trace_inst_t) == static_cast<size_t>(st.st_size);
+    if (!valid) {
+        munmap(map, st.st_size);
+        return false;
+    }
+    cache->insts = reinterpret_cast<const trace_inst_t*>(header + 1);
+    cache->count = header->count;
+    cache->map = map;
+    cache->map_len = st.st_size;
+    return true;
+}
+
+bool trace_cache_store(const char* dir, uint64_t hash, const trace_inst_t* insts, size_t count)
+{
+    std::string path = cache_path(dir, hash);
+    std::string tmp = path + ".tmp." + std::to_string(static_cast<long>(getpid()));
+    FILE* out = fopen(tmp.c_str(), "wb");
+    if (out == NULL) return false;
+
+    trace_cache_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TRACE_CACHE_MAGIC, TRACE_MAGIC_LEN);
+    header.version = TRACE_CACHE_VERSION;
+    header.inst_size = sizeof(trace_inst_t);
+    header.content_hash = hash;
+    header.count = count;
+    bool ok = fwrite(&header, sizeof(header), 1, out) == 1 &&
+              fwrite(insts, sizeof(trace_inst_t), count, out) == count;
+    ok = (fclose(out) == 0) && ok;
+    // Publish atomically so readers never see a partial entry
+    if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+        unlink(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+void trace_cache_detach(trace_cache_t* cache)
+{
+    if (cache->map != NULL) {
+        munmap(cache->map, cache->map_len);
+    }
+    memset(cache, 0, sizeof(*cache));
+}
@@ -0,0 +1,45 @@
+#ifndef TRACE_CACHE_HPP
+#define TRACE_CACHE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include "trace.hpp"
+
+// Decoded-trace cache. A trace is decoded once into an array of trace_inst_t
+// and stored as <dir>/<content hash>.pstc; later runs map that file read-only
+// and simulate straight from it, skipping parsing entirely. Files are written
+// under a temporary name and renamed into place, so concurrent runs are safe.
+#define TRACE_CACHE_MAGIC "PSCACHE1"
+#define TRACE_CACHE_VERSION 2
+#define TRACE_CACHE_SUFFIX ".pstc"
+
+typedef struct _trace_cache_header_t
+{
+    char magic[TRACE_MAGIC_LEN];
+    uint32_t version;
+    uint32_t inst_size;       // sizeof(trace_inst_t) of the writer
+    uint64_t content_hash;
+    uint64_t count;
+    uint64_t reserved[4];     // Pads the header so the array starts 64-byte aligned
+} trace_cache_header_t;
+
+typedef struct _trace_cache_t
+{
+    const trace_inst_t* insts;
+    size_t count;
+    void* map;
+    size_t map_len;
+} trace_cache_t;
+
+// Content hash of a mapped trace file; false if the reader is not backed by a mapping
+bool trace_content_hash(const trace_reader_t* reader, uint64_t* hash);
+
+// Map the cache entry for hash; false if there is no valid entry
+bool trace_cache_attach(const char* dir, uint64_t hash, trace_cache_t* cache);
+
+// Store a decoded trace as the cache entry for hash
+bool trace_cache_store(const char* dir, uint64_t hash, const trace_inst_t* insts, size_t count);
+
+void trace_cache_detach(trace_cache_t* cache);
+
+#endif /* TRACE_CACHE_HPP */
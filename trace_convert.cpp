@@ -0,0 +1,105 @@
+#include <cstdio>
+#include <cinttypes>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include "trace.hpp"
+
+// Converts procsim traces between the text and binary formats. The input
+// format is detected automatically; the output is binary unless -t is given.
+
+void print_help_and_exit(void) {
+    printf("trace_convert [OPTIONS]\n");
+    printf("  -i file\tInput trace (text or binary, optionally compressed; default stdin)\n");
+    printf("  -o file\tOutput trace (required)\n");
+    printf("  -d\t\tDelta-encode instruction addresses (binary output)\n");
+    printf("  -m\t\tKeep data addresses (binary output)\n");
+    printf("  -t\t\tWrite the text format instead of binary\n");
+    printf("  -h\t\tThis helpful output\n");
+    exit(0);
+}
+
+int main(int argc, char* argv[]) {
+    int opt;
+    FILE* in = stdin;
+    const char* out_path = NULL;
+    uint32_t flags = 0;
+    bool to_text = false;
+
+    while(-1 != (opt = getopt(argc, argv, "i:o:dmth"))) {
+        switch(opt) {
+        case 'i':
+            in = fopen(optarg, "rb");
+            if (in == NULL) {
+                fprintf(stderr, "Failed to open %s for reading\n", optarg);
+                return 1;
+            }
+            break;
+        case 'o':
+            out_path = optarg;
+            break;
+        case 'd':
+            flags |= TRACE_FLAG_DELTA_PC;
+            break;
+        case 'm':
+            flags |= TRACE_FLAG_DATA_ADDR;
+            break;
+        case 't':
+            to_text = true;
+            break;
+        case 'h':
+            /* Fall through */
+        default:
+            print_help_and_exit();
+            break;
+        }
+    }
+    if (out_path == NULL) print_help_and_exit();
+
+    FILE* out = fopen(out_path, to_text ? "w" : "wb");
+    if (out == NULL) {
+        fprintf(stderr, "Failed to open %s for writing\n", out_path);
+        return 1;
+    }
+
+    static trace_reader_t reader;
+    if (!trace_open(&reader, in)) return 1;
+
+    // The record count is patched into the header once it is known
+    if (!to_text && !trace_write_header(out, flags, 0)) {
+        fprintf(stderr, "Failed to write %s\n", out_path);
+        return 1;
+    }
+
+    trace_inst_t inst;
+    uint64_t count = 0;
+    uint32_t prev_address = 0;
+    while (trace_next(&reader, &inst)) {
+        if (to_text) {
+            fprintf(out, "%x %d %d %d %d", inst.instruction_address, inst.op_code,
+                    inst.dest_reg, inst.src_reg[0], inst.src_reg[1]);
+            if (inst.data_address != 0) fprintf(out, " %x", inst.data_address);
+            fprintf(out, "\n");
+        } else {
+            trace_record_t rec;
+            if (!trace_encode(&inst, flags, &prev_address, &rec)) {
+                fprintf(stderr, "Instruction %" PRIu64 " has a field outside the binary range\n", count + 1);
+                return 1;
+            }
+            fwrite(&rec, sizeof(rec), 1, out);
+            if (flags & TRACE_FLAG_DATA_ADDR) fwrite(&inst.data_address, sizeof(inst.data_address), 1, out);
+        }
+        ++count;
+    }
+
+    if (!to_text && fseek(out, 0, SEEK_SET) == 0) {
+        trace_write_header(out, flags, count);
+    }
+    trace_close(&reader);
+    if (fclose(out) != 0) {
+        fprintf(stderr, "Failed to write %s\n", out_path);
+        return 1;
+    }
+    fprintf(stderr, "Converted %" PRIu64 " instructions\n", count);
+    return 0;
+}
@@ -0,0 +1,62 @@
+#include <chrono>
+#include "trace_stream.hpp"
+
+static void stream_producer(trace_stream_t* stream) {
+    while (true) {
+        uint64_t p = stream->produced.load(std::memory_order_relaxed);
+        // Wait for a free slot; the consumer may be busy for a while, so sleep
+        while (p - stream->consumed.load(std::memory_order_acquire) >= TRACE_STREAM_SLOTS) {
+            if (stream->stop.load(std::memory_order_relaxed)) return;
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+        if (stream->stop.load(std::memory_order_relaxed)) return;
+        size_t slot = p % TRACE_STREAM_SLOTS;
+        size_t n = trace_next_batch(stream->reader, stream->slots + slot * TRACE_BATCH_SIZE, TRACE_BATCH_SIZE);
+        stream->counts[slot] = n;
+        stream->produced.store(p + 1, std::memory_order_release);
+        if (n == 0) return;
+    }
+}
+
+void trace_stream_start(trace_stream_t* stream, trace_reader_t* reader)
+{
+    stream->reader = reader;
+    stream->slots = new trace_inst_t[TRACE_STREAM_SLOTS * TRACE_BATCH_SIZE];
+    stream->produced = 0;
+    stream->consumed = 0;
+    stream->stop = false;
+    stream->holding = false;
+    stream->ended = false;
+    stream->producer = std::thread(stream_producer, stream);
+}
+
+size_t trace_stream_next(trace_stream_t* stream, const trace_inst_t** batch)
+{
+    if (stream->ended) return 0;
+    uint64_t c = stream->consumed.load(std::memory_order_relaxed);
+    if (stream->holding) {
+        stream->consumed.store(++c, std::memory_order_release);
+        stream->holding = false;
+    }
+    // The producer is normally ahead; spin briefly, then give it the CPU
+    for (unsigned spins = 0; stream->produced.load(std::memory_order_acquire) == c; ++spins) {
+        if (spins >= 1024) std::this_thread::yield();
+    }
+    size_t slot = c % TRACE_STREAM_SLOTS;
+    size_t n = stream->counts[slot];
+    if (n == 0) {
+        stream->ended = true;
+        return 0;
+    }
+    *batch = stream->slots + slot * TRACE_BATCH_SIZE;
+    stream->holding = true;
+    return n;
+}
+
+void trace_stream_stop(trace_stream_t* stream)
+{
+    stream->stop.store(true, std::memory_order_relaxed);
+    if (stream->producer.joinable()) stream->producer.join();
+    delete[] stream->slots;
+    stream->slots = NULL;
+}
@@ -0,0 +1,43 @@
+#ifndef TRACE_STREAM_HPP
+#define TRACE_STREAM_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include "trace.hpp"
+
+// Batches the background decoder may run ahead of the simulation
+#define TRACE_STREAM_SLOTS 8
+
+// Background trace decoding, for inputs that cannot be parsed in place
+// (compressed files and pipes). A producer thread reads, decompresses and
+// parses the trace batch by batch into a ring of TRACE_STREAM_SLOTS batches,
+// and the simulation takes them in order, so decoding overlaps with simulation.
+// Single producer, single consumer: each side only advances its own counter and
+// reads the other's, so no lock is taken.
+typedef struct _trace_stream_t
+{
+    trace_reader_t* reader;
+    trace_inst_t* slots;                  // TRACE_STREAM_SLOTS batches of TRACE_BATCH_SIZE
+    size_t counts[TRACE_STREAM_SLOTS];    // Instructions in each batch, 0 = end of trace
+    std::atomic<uint64_t> produced;       // Batches written by the producer
+    std::atomic<uint64_t> consumed;       // Batches handed back by the consumer
+    std::atomic<bool> stop;
+    bool holding;                         // The consumer holds batch `consumed`
+    bool ended;
+    std::thread producer;
+} trace_stream_t;
+
+// Start decoding reader on a producer thread; the reader belongs to it until
+// trace_stream_stop()
+void trace_stream_start(trace_stream_t* stream, trace_reader_t* reader);
+
+// Next batch of decoded instructions: returns its size, 0 at the end of the trace.
+// The batch stays valid until the next call.
+size_t trace_stream_next(trace_stream_t* stream, const trace_inst_t** batch);
+
+// Stop the producer and wait for it
+void trace_stream_stop(trace_stream_t* stream);
+
+#endif /* TRACE_STREAM_HPP */